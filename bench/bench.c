@@ -0,0 +1,237 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Scaling benchmark. Economies of several sizes are run with several
+   thread counts and a fixed seed, each configuration within its own
+   child process so that its peak resident set size can be measured
+   separately. Results are written as JSON */
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "econ.h"
+
+#define BENCH_MAX_VALUES 16
+
+typedef struct
+{
+    unsigned int ticks;
+    double seconds;
+    long peak_rss_kb;
+} BenchResult;
+
+static double bench_time(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/* parses a comma separated list of numbers. Returns the number of
+   values, or zero if the list is malformed or too long */
+static unsigned int bench_list(const char * text, unsigned int * values)
+{
+    unsigned int n = 0;
+    char * end;
+
+    while (*text != 0) {
+        if (n == BENCH_MAX_VALUES) {
+            fprintf(stderr, "At most %d values may be listed\n",
+                    BENCH_MAX_VALUES);
+            return 0;
+        }
+        values[n] = (unsigned int)strtoul(text, &end, 10);
+        if ((end == text) || (values[n] == 0)) return 0;
+        n++;
+        text = end;
+        if (*text == ',') text++;
+    }
+    return n;
+}
+
+/* Runs one configuration, after a number of warm up ticks. Ticks are
+   measured until either the given number have been run or the time
+   limit has passed */
+static int bench_run(EconomyConfig * config, unsigned int warmup, unsigned int ticks,
+                     double limit, BenchResult * result)
+{
+    Economy * e;
+    struct rusage usage;
+    unsigned int t;
+    double start;
+
+    e = econ_create(config);
+    if (e == NULL) return -1;
+    for (t = 0; t < warmup; t++) {
+        econ_update(e, 1);
+    }
+
+    start = bench_time();
+    result->ticks = 0;
+    while (result->ticks < ticks) {
+        econ_update(e, 1);
+        result->ticks++;
+        if (bench_time() - start > limit) break;
+    }
+    result->seconds = bench_time() - start;
+    econ_destroy(e);
+
+    getrusage(RUSAGE_SELF, &usage);
+    result->peak_rss_kb = usage.ru_maxrss;
+    return 0;
+}
+
+/* runs a configuration within a child process */
+static int bench_child(EconomyConfig * config, unsigned int warmup, unsigned int ticks,
+                       double limit, BenchResult * result)
+{
+    int fd[2], status;
+    pid_t pid;
+    ssize_t n;
+
+    if (pipe(fd) != 0) return -1;
+    fflush(NULL);
+    pid = fork();
+    if (pid < 0) {
+        close(fd[0]);
+        close(fd[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fd[0]);
+        if (bench_run(config, warmup, ticks, limit, result) != 0) _exit(1);
+        if (write(fd[1], result, sizeof(BenchResult)) != (ssize_t)sizeof(BenchResult)) _exit(1);
+        _exit(0);
+    }
+    close(fd[1]);
+    n = read(fd[0], result, sizeof(BenchResult));
+    close(fd[0]);
+    if (waitpid(pid, &status, 0) != pid) return -1;
+    if ((n != (ssize_t)sizeof(BenchResult)) ||
+        (!WIFEXITED(status)) || (WEXITSTATUS(status) != 0)) return -1;
+    return 0;
+}
+
+static void bench_usage(void)
+{
+    fprintf(stderr,
+            "econ-bench [--sizes N,...] [--threads N,...] [--ticks N] [--warmup N]\n"
+            "           [--seconds S] [--seed N] [--tick serial|phased|parallel]\n"
+            "           [--no-simd]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    const char * modes[] = { "serial", "phased", "parallel" };
+    unsigned int sizes[BENCH_MAX_VALUES] = { 1000, 10000, 100000, 1000000 };
+    unsigned int threads[BENCH_MAX_VALUES] = { 1, 2, 4 };
+    unsigned int size_count = 4, thread_count = 3, warmup = 2, ticks = 10;
+    unsigned int i, j, mode;
+    double limit = 10;
+    int a, first = 1;
+    EconomyConfig config;
+    BenchResult result;
+
+    econ_config_init(&config);
+    config.tick_mode = TICK_PARALLEL;
+    for (a = 1; a < argc; a++) {
+        if ((a + 1 < argc) && (strcmp(argv[a], "--sizes") == 0)) {
+            size_count = bench_list(argv[++a], sizes);
+        }
+        else if ((a + 1 < argc) && (strcmp(argv[a], "--threads") == 0)) {
+            thread_count = bench_list(argv[++a], threads);
+        }
+        else if ((a + 1 < argc) && (strcmp(argv[a], "--ticks") == 0)) {
+            ticks = (unsigned int)atoi(argv[++a]);
+        }
+        else if ((a + 1 < argc) && (strcmp(argv[a], "--warmup") == 0)) {
+            warmup = (unsigned int)atoi(argv[++a]);
+        }
+        else if ((a + 1 < argc) && (strcmp(argv[a], "--seconds") == 0)) {
+            limit = atof(argv[++a]);
+        }
+        else if ((a + 1 < argc) && (strcmp(argv[a], "--seed") == 0)) {
+            config.seed = (uint64_t)strtoull(argv[++a], NULL, 10);
+        }
+        else if ((a + 1 < argc) && (strcmp(argv[a], "--tick") == 0)) {
+            a++;
+            for (mode = 0; mode < TICK_MODES; mode++) {
+                if (strcmp(argv[a], modes[mode]) == 0) break;
+            }
+            if (mode == TICK_MODES) {
+                bench_usage();
+                return 1;
+            }
+            config.tick_mode = mode;
+        }
+        else if (strcmp(argv[a], "--no-simd") == 0) {
+            config.simd = 0;
+        }
+        else {
+            bench_usage();
+            return 1;
+        }
+    }
+    if ((size_count == 0) || (thread_count == 0) || (ticks == 0)) {
+        bench_usage();
+        return 1;
+    }
+
+    printf("{\n");
+    printf("  \"seed\": %llu,\n", (unsigned long long)config.seed);
+    printf("  \"tick_mode\": \"%s\",\n", modes[config.tick_mode]);
+    printf("  \"simd\": %s,\n", config.simd ? "true" : "false");
+    printf("  \"warmup_ticks\": %u,\n", warmup);
+    printf("  \"cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    printf("  \"results\": [");
+    for (i = 0; i < size_count; i++) {
+        for (j = 0; j < thread_count; j++) {
+            config.size = sizes[i];
+            config.threads = threads[j];
+            printf("%s\n    { \"size\": %u, \"threads\": %u, ",
+                   first ? "" : ",", sizes[i], threads[j]);
+            first = 0;
+            if (bench_child(&config, warmup, ticks, limit, &result) != 0) {
+                printf("\"error\": true }");
+                continue;
+            }
+            printf("\"ticks\": %u, \"seconds\": %.6f, \"ticks_per_sec\": %.3f, "
+                   "\"ns_per_firm_tick\": %.1f, \"peak_rss_kb\": %ld }",
+                   result.ticks, result.seconds, result.ticks / result.seconds,
+                   result.seconds * 1e9 / ((double)result.ticks * sizes[i]),
+                   result.peak_rss_kb);
+        }
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
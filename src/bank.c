@@ -35,53 +35,198 @@
 
 #include "econ.h"
 
-void bank_init(Bank * b)
+/* Interest on a loan is compounded daily. Rather than evaluating the
+   compound interest equation afresh on every update, the amount due is
+   kept with the loan and multiplied by the growth over the days since
+   the last update. That factor only needs recomputing if the number of
+   days between updates changes */
+static void bank_loan_schedule(Account * a)
+{
+    a->loan_due = a->loan;
+    a->loan_accrual = 1;
+    a->loan_accrual_days = 0;
+}
+
+/* schedules the next check of whether a loan has been repaid. Repayments
+   are made at a fixed rate, so the days until the repayments reach the
+   amount now due is an underestimate of when the loan will be repaid,
+   since interest accrues meanwhile. One day is taken off to allow for
+   rounding */
+static void bank_loan_check(Bank * b, unsigned int account_index)
+{
+    Account * a = &b->account[account_index];
+    double days = (a->loan_due - a->loan_repaid) * 30.0 / a->loan_repayment_per_month;
+    unsigned int when = b->maturities.now + 1;
+
+    if (days > 1.0e9) days = 1.0e9;
+    if (days > 2) when = b->maturities.now + (unsigned int)days - 1;
+    a->loan_check_day = when;
+    wheel_insert(&b->maturities, account_index, when);
+}
+
+static double bank_loan_accrual(Account * a, unsigned int days)
+{
+    if (a->loan_accrual_days != days) {
+        a->loan_accrual = pow(1.0 + (a->loan_interest_rate/(100.0*365.0)), days);
+        a->loan_accrual_days = days;
+    }
+    return a->loan_accrual;
+}
+
+/* clears a range of account slots and puts them on the free list, so
+   that the lowest of them is allocated first */
+static void bank_account_clear(Bank * b, unsigned int start, unsigned int end)
 {
     unsigned int i;
+    Account * a;
+
+    for (i = end; i > start; i--) {
+        a = &b->account[i-1];
+        a->entity_type = ENTITY_NONE;
+        a->entity_index = 0;
+        a->next.bank = -1;
+        a->next.slot = b->free_account;
+        a->balance = 0;
+        a->loan = 0;
+        a->loan_interest_rate = 0;
+        a->loan_elapsed_days = 0;
+        a->loan_repaid = 0;
+        a->loan_repayment_per_month = 0;
+        bank_loan_schedule(a);
+        b->free_account = (int)(i-1);
+    }
+}
+
+/* takes an account slot from the free list, doubling the number of slots
+   if none are free. Returns the slot, or -1 if out of memory */
+static int bank_account_alloc(Bank * b)
+{
+    unsigned int capacity = b->max_accounts * 2;
+    Account * account;
+    unsigned int * live;
+    int account_index;
 
-    b->tax_location = (unsigned int)(rand()%LOCATIONS);
+    if (b->free_account < 0) {
+        if (capacity < 2) capacity = 2;
+        account = (Account*)realloc(b->account, capacity*sizeof(Account));
+        if (account == NULL) return -1;
+        b->account = account;
+        live = (unsigned int*)realloc(b->live, capacity*sizeof(unsigned int));
+        if (live == NULL) return -1;
+        b->live = live;
+        if (wheel_resize(&b->maturities, capacity) != 0) return -1;
+        bank_account_clear(b, b->max_accounts, capacity);
+        b->max_accounts = capacity;
+    }
+    account_index = b->free_account;
+    b->free_account = b->account[account_index].next.slot;
+    b->account[account_index].next.slot = -1;
+    return account_index;
+}
+
+/* allocates the given number of account slots for a bank, along with
+   its list of open accounts and schedule of loans. Returns zero on success */
+int bank_alloc(Bank * b, unsigned int accounts)
+{
+    b->max_accounts = accounts;
+    b->account = (Account*)malloc(accounts*sizeof(Account));
+    b->live = (unsigned int*)malloc(accounts*sizeof(unsigned int));
+    if (wheel_init(&b->maturities, accounts) != 0) return -1;
+    if ((b->account == NULL) || (b->live == NULL)) return -1;
+    return 0;
+}
+
+void bank_free(Bank * b)
+{
+    free(b->account);
+    free(b->live);
+    wheel_free(&b->maturities);
+    b->account = NULL;
+    b->live = NULL;
+}
+
+/* restores a bank from a saved copy and its accounts, rebuilding its
+   list of open accounts and its schedule of loans. The saved copy may
+   come from a damaged file, so each open account must have its own
+   position within the list of open accounts, and the free list must
+   pass through every closed slot exactly once. Returns zero on success */
+int bank_restore(Bank * b, Bank * saved, Account * accounts)
+{
+    unsigned int i, open = 0, now = saved->maturities.now;
+    unsigned int closed;
+    int slot;
+    Account * a;
+
+    bank_free(b);
+    *b = *saved;
+    b->account = NULL;
+    b->live = NULL;
+    b->maturities.capacity = 0;
+    if (bank_alloc(b, saved->max_accounts) != 0) return -1;
+    if (b->active_accounts > b->max_accounts) return -1;
+    memcpy(b->account, accounts, b->max_accounts*sizeof(Account));
+
+    /* unfilled positions hold max_accounts, which is never a slot */
+    for (i = 0; i < b->active_accounts; i++) {
+        b->live[i] = b->max_accounts;
+    }
+    wheel_clear(&b->maturities, now);
+    for (i = 0; i < b->max_accounts; i++) {
+        a = &b->account[i];
+        if (bank_account_defunct(a)) continue;
+        if ((a->live_position >= b->active_accounts) ||
+            (b->live[a->live_position] != b->max_accounts)) return -1;
+        b->live[a->live_position] = i;
+        if (a->loan > 0) wheel_insert(&b->maturities, i, a->loan_check_day);
+        open++;
+    }
+    if (open != b->active_accounts) return -1;
+
+    /* a cycle would never reach the end within the number of closed slots */
+    closed = b->max_accounts - b->active_accounts;
+    slot = b->free_account;
+    for (i = 0; (i < closed) && (slot >= 0); i++) {
+        if ((unsigned int)slot >= b->max_accounts) return -1;
+        a = &b->account[slot];
+        if (!bank_account_defunct(a)) return -1;
+        slot = a->next.slot;
+    }
+    return ((i == closed) && (slot == -1)) ? 0 : -1;
+}
+
+void bank_init(Bank * b, Params * p, Rng * rng)
+{
+    b->tax_location = rng_range(rng, p->locations);
     b->capital.repayment_per_month = 0;
     b->capital.variable = 0;
     b->capital.constant = 0;
     b->capital.surplus = 0;
-    b->capital.fictitious = INITIAL_BANK_DEPOSIT;
+    b->capital.fictitious = p->initial_bank_deposit;
     b->interest_deposit =
-        MIN_BANK_INTEREST +
-        ((rand()%10000/10000.0)*(MAX_BANK_INTEREST - MIN_BANK_INTEREST));
+        p->min_bank_interest +
+        (rng_uniform(rng)*(p->max_bank_interest - p->min_bank_interest));
     b->interest_loan =
         b->interest_deposit +
-        ((rand()%10000/10000.0)*(MAX_LOAN_INTEREST - b->interest_deposit));
+        (rng_uniform(rng)*(p->max_loan_interest - b->interest_deposit));
     b->active_accounts = 0;
-    for (i = 0; i < MAX_ACCOUNTS; i++) {
-        b->account[i].entity_type = ENTITY_NONE;
-        b->account[i].entity_index = 0;
-        b->account[i].balance = 0;
-        b->account[i].loan = 0;
-        b->account[i].loan_interest_rate = 0;
-        b->account[i].loan_elapsed_days = 0;
-        b->account[i].loan_repaid = 0;
-        b->account[i].loan_repayment_per_month = 0;
-    }
+    b->loans = 0;
+    b->balances = 0;
+    b->free_account = -1;
+    bank_account_clear(b, 0, b->max_accounts);
+    wheel_clear(&b->maturities, 0);
 	clear_history(&b->capital);
 }
 
 int bank_account_defunct(Account * a)
 {
-    return (a->entity_index == ENTITY_NONE);
+    return (a->entity_type == ENTITY_NONE);
 }
 
+/* the totals of loans and balances are kept as accounts change */
 float bank_worth(Bank * b)
 {
-    unsigned int i;
-    Account * a;
-    float total = b->capital.surplus + b->capital.fictitious;
-
-    for (i = 0; i < MAX_ACCOUNTS; i++) {
-        a = &b->account[i];
-        if (bank_account_defunct(a)) continue;
-        total += a->loan - a->balance;
-    }
-    return total;
+    return (float)((double)b->capital.surplus + b->capital.fictitious +
+                   b->loans - b->balances);
 }
 
 int bank_defunct(Bank * b)
@@ -89,65 +234,153 @@ int bank_defunct(Bank * b)
     return (bank_worth(b) < 0);
 }
 
-int bank_account_index(Bank * b, unsigned int entity_type, unsigned int entity_index)
+/* returns the number of entities of the given type */
+static unsigned int bank_index_entities(Economy * e, unsigned int entity_type)
 {
-    unsigned int i;
-    Account * a;
+    switch(entity_type) {
+    case ENTITY_FIRM: return e->size;
+    case ENTITY_MERCHANT: return 1;
+    case ENTITY_BANK: return e->banks;
+    case ENTITY_STATE: return MAX_LOCATIONS;
+    case ENTITY_RENTIER: return e->rentiers;
+    }
+    return 0;
+}
 
-    if (b->active_accounts == 0) return -1;
+/* allocates the index of accounts held by each entity. Returns zero on success */
+int bank_index_init(Economy * e)
+{
+    unsigned int t, n;
 
-    for (i = 0; i < MAX_ACCOUNTS; i++) {
-        a = &b->account[i];
-        if (bank_account_defunct(a)) continue;
-        if (a->entity_type != entity_type) continue;
-        if (a->entity_index != entity_index) continue;
-        return (int)i;
+    for (t = ENTITY_NONE + 1; t < ENTITIES; t++) {
+        n = bank_index_entities(e, t);
+        if (n == 0) continue;
+        e->account_list[t] = (AccountRef*)malloc(n*sizeof(AccountRef));
+        if (e->account_list[t] == NULL) return -1;
+    }
+    return 0;
+}
+
+void bank_index_free(Economy * e)
+{
+    unsigned int t;
+
+    for (t = 0; t < ENTITIES; t++) {
+        free(e->account_list[t]);
+        e->account_list[t] = NULL;
     }
-    return -1;
 }
 
-/* compound interest equation */
-float bank_loan_due(Account * a)
+/* returns the first of the accounts held by an entity, or NULL if there
+   is no such entity */
+AccountRef * bank_account_list(Economy * e, unsigned int entity_type, unsigned int entity_index)
 {
-    float v, interest_rate = a->loan_interest_rate/100.0f;
-    v = 1.0f + (interest_rate/365.0f);
-    return a->loan * pow(v, 365.0f * a->loan_elapsed_days);
+    if ((entity_type >= ENTITIES) || (e->account_list[entity_type] == NULL) ||
+        (entity_index >= bank_index_entities(e, entity_type))) return NULL;
+    return &e->account_list[entity_type][entity_index];
+}
+
+/* adds an account to the list of those held by its entity */
+static void bank_account_link(Bank * b, Economy * e, unsigned int account_index)
+{
+    Account * a = &b->account[account_index];
+    AccountRef * list = bank_account_list(e, a->entity_type, a->entity_index);
+
+    if (list == NULL) return;
+    a->next = *list;
+    list->bank = (int)(b - e->bank);
+    list->slot = (int)account_index;
+}
+
+/* removes an account from the list of those held by its entity. As an
+   entity holds at most one account with each bank the list is short */
+static void bank_account_unlink(Bank * b, Economy * e, unsigned int account_index)
+{
+    Account * a = &b->account[account_index];
+    AccountRef * ref = bank_account_list(e, a->entity_type, a->entity_index);
+    int bank = (int)(b - e->bank);
+
+    if (ref == NULL) return;
+    while (ref->bank >= 0) {
+        if ((ref->bank == bank) && (ref->slot == (int)account_index)) {
+            *ref = a->next;
+            break;
+        }
+        ref = &e->bank[ref->bank].account[ref->slot].next;
+    }
+    a->next.bank = -1;
+    a->next.slot = -1;
+}
+
+/* rebuilds the index of accounts held by each entity from the banks */
+void bank_index_rebuild(Economy * e)
+{
+    unsigned int t, i, n;
+
+    for (t = 0; t < ENTITIES; t++) {
+        n = bank_index_entities(e, t);
+        for (i = 0; i < n; i++) {
+            e->account_list[t][i].bank = -1;
+            e->account_list[t][i].slot = -1;
+        }
+    }
+    for (i = e->banks; i > 0; i--) {
+        for (n = e->bank[i-1].max_accounts; n > 0; n--) {
+            if (bank_account_defunct(&e->bank[i-1].account[n-1])) continue;
+            bank_account_link(&e->bank[i-1], e, n-1);
+        }
+    }
+}
+
+/* removes the accounts of a bank from the index, before it is restarted */
+void bank_index_remove(Bank * b, Economy * e)
+{
+    unsigned int i;
+
+    for (i = 0; i < b->active_accounts; i++) {
+        bank_account_unlink(b, e, b->live[i]);
+    }
+}
+
+int bank_account_index(Bank * b, Economy * e, unsigned int entity_type, unsigned int entity_index)
+{
+    AccountRef * list = bank_account_list(e, entity_type, entity_index);
+    AccountRef ref;
+    int bank = (int)(b - e->bank);
+
+    if (list == NULL) return -1;
+    for (ref = *list; ref.bank >= 0; ref = e->bank[ref.bank].account[ref.slot].next) {
+        PROFILE_COUNT(e, COUNT_ACCOUNT_PROBES, 1);
+        if (ref.bank == bank) return ref.slot;
+    }
+    return -1;
 }
 
 void bank_issue_loan(Bank * b, Economy * e,
                      unsigned int entity_type, unsigned int entity_index,
                      float amount, unsigned int repayment_days)
 {
-    int account_index;
+    int account_index, created = 0;
     float repayment_per_month;
-    unsigned int i;
     Firm * firm_borrowing;
     Bank * bank_borrowing;
     State * state_borrowing;
 
-    account_index = bank_account_index(b, entity_type, entity_index);
+    account_index = bank_account_index(b, e, entity_type, entity_index);
     if (account_index == -1) {
-        if (b->active_accounts >= MAX_ACCOUNTS) return;
-        for (i = 0; i < b->active_accounts; i++) {
-            if (bank_account_defunct(&b->account[i])) {
-                account_index = (int)i;
-                break;
-            }
-        }
-        if ((account_index == -1) &&
-            (b->active_accounts < MAX_ACCOUNTS-1)) {
-            account_index = (int)b->active_accounts;
-            b->active_accounts++;
-        }
+        account_index = bank_account_alloc(b);
+        if (account_index == -1) return;
+        created = 1;
     }
-    if (account_index == -1) {
+    else if (b->account[account_index].loan > 0) {
         return;
     }
-    if (b->account[account_index].loan > 0) return;
 
     repayment_per_month = amount * 2 / ((float)repayment_days/30.0f);
 
     b->capital.fictitious -= amount;
+    b->loans += amount;
+    b->balances -= b->account[account_index].balance;
     b->account[account_index].entity_type = entity_type;
     b->account[account_index].entity_index = entity_index;
     b->account[account_index].balance = 0;
@@ -156,6 +389,14 @@ void bank_issue_loan(Bank * b, Economy * e,
     b->account[account_index].loan_elapsed_days = 0;
     b->account[account_index].loan_repaid = 0;
     b->account[account_index].loan_repayment_per_month = repayment_per_month;
+    bank_loan_schedule(&b->account[account_index]);
+    bank_loan_check(b, (unsigned int)account_index);
+    if (created) {
+        bank_account_link(b, e, (unsigned int)account_index);
+        b->account[account_index].live_position = b->active_accounts;
+        b->live[b->active_accounts++] = (unsigned int)account_index;
+    }
+    PROFILE_COUNT(e, COUNT_LOANS_ISSUED, 1);
 
     switch(entity_type) {
     case ENTITY_FIRM: {
@@ -186,6 +427,7 @@ void bank_loan_close(Bank * b, Economy * e, Account * a)
     State * state_borrowing;
 
     if (bank_account_defunct(a)) return;
+    if (a->loan > 0) PROFILE_COUNT(e, COUNT_LOANS_CLOSED, 1);
 
     switch(a->entity_type) {
     case ENTITY_FIRM: {
@@ -205,29 +447,43 @@ void bank_loan_close(Bank * b, Economy * e, Account * a)
     }
     }
 
+    wheel_remove(&b->maturities, (unsigned int)(a - b->account));
+    b->loans -= a->loan;
     a->loan = 0;
     a->loan_repaid = 0;
     a->loan_repayment_per_month = 0;
 }
 
+/* closes an account, along with any loan on it */
+void bank_account_close(Bank * b, Economy * e, unsigned int account_index)
+{
+    Account * a = &b->account[account_index];
+    unsigned int last;
+
+    if (bank_account_defunct(a)) return;
+    bank_loan_close(b, e, a);
+    bank_account_unlink(b, e, account_index);
+    b->balances -= a->balance;
+    a->balance = 0;
+    a->entity_type = ENTITY_NONE;
+    a->entity_index = 0;
+    a->next.slot = b->free_account;
+    b->free_account = (int)account_index;
+
+    /* the last open account takes its place in the list */
+    last = b->live[--b->active_accounts];
+    b->live[a->live_position] = last;
+    b->account[last].live_position = a->live_position;
+}
+
 void bank_account_close_entity(Bank * b, Economy * e, unsigned int entity_type, unsigned int entity_index)
 {
-    Account * a;
-    unsigned int i;
+    int account_index = bank_account_index(b, e, entity_type, entity_index);
 
-    for (i = 0; i < MAX_ACCOUNTS; i++) {
-        a = &b->account[i];
-        if (bank_account_defunct(a)) continue;
-        if ((a->entity_type == entity_type) &&
-            (a->entity_index == entity_index)) {
-            bank_loan_close(b, e, a);
-            a->entity_index = ENTITY_NONE;
-            a->entity_index = 0;
-            b->active_accounts--;
-        }
-    }
+    if (account_index >= 0) bank_account_close(b, e, (unsigned int)account_index);
 }
 
+/* transfers a repayment, already added to the loan, from the borrower */
 void bank_loan_repay(Bank * b, Economy * e, Account * a, unsigned int increment_days)
 {
     Firm * firm_borrowing;
@@ -255,102 +511,75 @@ void bank_loan_repay(Bank * b, Economy * e, Account * a, unsigned int increment_
         break;
     }
     }
-    a->loan_repaid += repayment;
 }
 
-void bank_account_update(Bank * b, Economy * e, unsigned int account_index, unsigned int increment_days)
+/* accrues interest on the balances and loans of every open account in
+   one scalar pass over the list of open accounts. This only touches the
+   accounts themselves. Accounts are reached through the list, so the
+   loop is not vectorised, and each loan's growth factor is recomputed
+   with pow() only when the days between updates change */
+static void bank_accounts_accrue(Bank * b, unsigned int increment_days)
 {
-    Account * a = &b->account[account_index];
-    if (bank_account_defunct(a)) return;
-
-    if (a->balance > 0) {
-        a->balance *= (1.0f + (b->interest_deposit/100.0f));
-    }
-    if (a->loan > 0) {
-        a->loan_elapsed_days += increment_days;
-
-        bank_loan_repay(b, e, a, increment_days);
+    unsigned int i;
+    float interest_deposit = 1.0f + (b->interest_deposit/100.0f);
+    Account * a;
 
-        if (a->loan_repaid >= bank_loan_due(a)) {
-            bank_loan_close(b, e, a);
+    for (i = 0; i < b->active_accounts; i++) {
+        a = &b->account[b->live[i]];
+        if (a->balance > 0) {
+            b->balances -= a->balance;
+            a->balance *= interest_deposit;
+            b->balances += a->balance;
         }
+        if (a->loan <= 0) continue;
+        a->loan_elapsed_days += increment_days;
+        a->loan_due *= bank_loan_accrual(a, increment_days);
+        a->loan_repaid += (float)increment_days * a->loan_repayment_per_month / 30.0f;
     }
 }
 
-float bank_average_interest_loan(Economy * e)
-{
-    unsigned int i, hits=0;
-    Bank * b;
-    float average = 0;
-
-    for (i = 0; i < MAX_BANKS; i++) {
-        b = &e->bank[i];
-        if (bank_defunct(b)) continue;
-        average += b->interest_loan;
-        hits++;
-    }
-    if (hits > 0) {
-        average /= (float)hits;
-    }
-    return average;
-}
-
-float bank_average_worth(Economy * e)
-{
-    unsigned int i, hits=0;
-    Bank * b;
-    float average = 0;
-
-    for (i = 0; i < MAX_BANKS; i++) {
-        b = &e->bank[i];
-        if (bank_defunct(b)) continue;
-        average += bank_worth(b);
-        hits++;
-    }
-    if (hits > 0) {
-        average /= (float)hits;
-    }
-    return average;
-}
-
-float bank_average_interest_deposit(Economy * e)
+/* takes the average loan rate and worth of the banks which are not
+   defunct. This is done once per tick, before the banks are updated */
+void bank_averages_update(Economy * e)
 {
-    unsigned int i, hits=0;
+    unsigned int i, hits = 0;
+    BankAverages * averages = &e->bank_averages;
     Bank * b;
-    float average = 0;
 
-    for (i = 0; i < MAX_BANKS; i++) {
+    averages->interest_loan = 0;
+    averages->worth = 0;
+    for (i = 0; i < e->banks; i++) {
         b = &e->bank[i];
         if (bank_defunct(b)) continue;
-        average += b->interest_deposit;
+        averages->interest_loan += b->interest_loan;
+        averages->worth += bank_worth(b);
         hits++;
     }
     if (hits > 0) {
-        average /= (float)hits;
+        averages->interest_loan /= (float)hits;
+        averages->worth /= (float)hits;
     }
-    return average;
 }
 
 void bank_strategy(Bank * b, Economy * e)
 {
-    float average = bank_average_interest_loan(e);
-    if (b->interest_loan > average * 1.05f) {
+    BankAverages * averages = &e->bank_averages;
+
+    if (b->interest_loan > averages->interest_loan * 1.05f) {
         b->interest_loan *= 0.99f;
     }
-    if (b->interest_loan < average * 0.95f) {
+    if (b->interest_loan < averages->interest_loan * 0.95f) {
         b->interest_loan *= 1.01f;
     }
 
-    average = bank_average_interest_loan(e);
-    if (b->interest_deposit > average * 1.05f) {
+    if (b->interest_deposit > averages->interest_loan * 1.05f) {
         b->interest_deposit *= 0.99f;
     }
-    if (b->interest_deposit < average * 0.95f) {
+    if (b->interest_deposit < averages->interest_loan * 0.95f) {
         b->interest_deposit *= 1.01f;
     }
 
-    average = bank_average_worth(e);
-    if (bank_worth(b) > average) {
+    if (bank_worth(b) > averages->worth) {
         b->interest_loan *= 1.01f;
         b->interest_deposit *= 0.99f;
     }
@@ -363,21 +592,37 @@ void bank_strategy(Bank * b, Economy * e)
 void bank_update(Bank * b, Economy * e, unsigned int increment_days)
 {
     unsigned int i;
+    int account_index;
     Account * a;
 
     if (bank_defunct(b)) return;
 
-    for (i = 0; i < MAX_ACCOUNTS; i++) {
-        bank_account_update(b, e, i, increment_days);
+    /* borrowers then make their repayments */
+    bank_accounts_accrue(b, increment_days);
+    for (i = 0; i < b->active_accounts; i++) {
+        a = &b->account[b->live[i]];
+        if (a->loan <= 0) continue;
+        bank_loan_repay(b, e, a, increment_days);
+    }
+
+    /* only loans which may have been repaid in full by now are checked */
+    wheel_advance(&b->maturities, b->maturities.now + increment_days);
+    while ((account_index = wheel_pop(&b->maturities)) != -1) {
+        a = &b->account[account_index];
+        if (a->loan_repaid >= a->loan_due) {
+            bank_loan_close(b, e, a);
+        }
+        else {
+            bank_loan_check(b, (unsigned int)account_index);
+        }
     }
 
     bank_strategy(b, e);
-    update_history(&b->capital);
+    update_history(&b->capital, e->params.history_steps);
 
     if (bank_defunct(b)) {
-        for (i = 0; i < MAX_ACCOUNTS; i++) {
-            a = &b->account[i];
-            bank_account_close_entity(b, e, a->entity_type, a->entity_index);
+        while (b->active_accounts > 0) {
+            bank_account_close(b, e, b->live[b->active_accounts - 1]);
         }
         e->bankruptcies++;
     }
@@ -389,7 +634,7 @@ Bank * best_bank_for_loan(Economy * e)
     Bank * b, * best = NULL;
     float min_interest_rate = 0;
 
-    for (i = 0; i < MAX_BANKS; i++) {
+    for (i = 0; i < e->banks; i++) {
         b = &e->bank[i];
         if (bank_defunct(b)) continue;
         if ((best == NULL) || (b->interest_loan < min_interest_rate)) {
@@ -406,7 +651,7 @@ Bank * best_bank_for_savings(Economy * e)
     Bank * b, * best = NULL;
     float max_interest_rate = 0;
 
-    for (i = 0; i < MAX_BANKS; i++) {
+    for (i = 0; i < e->banks; i++) {
         b = &e->bank[i];
         if (bank_defunct(b)) continue;
         if ((best == NULL) || (b->interest_deposit > max_interest_rate)) {
@@ -0,0 +1,356 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Binary checkpoints. The file begins with a header giving the format
+   version, an endianness tag and the sizes of the structures, followed
+   by the economy's counters, parameters, merchant and states. The firm,
+   bank, account and rentier arrays follow, each starting on a page
+   boundary and stored exactly as they are held in memory. The accounts
+   of every bank are stored one bank after another, as each bank may have
+   grown a different number of account slots. On loading,
+   the file is mapped privately and the firms and rentiers are used in
+   place, so that only the pages which are touched are ever read in.
+   The random number streams are derived from the seed and tick, and so
+   no further generator state needs to be saved. Indexes over the firms
+   are rebuilt after loading */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "econ.h"
+
+#define CHECKPOINT_MAGIC   "ECONCKPT"
+#define CHECKPOINT_VERSION 6
+#define CHECKPOINT_ENDIAN  0x01020304
+#define CHECKPOINT_ALIGN   4096
+
+enum {
+    CHECKPOINT_FIRM,
+    CHECKPOINT_BANK,
+    CHECKPOINT_ACCOUNT,
+    CHECKPOINT_RENTIER,
+    CHECKPOINT_SECTIONS
+};
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t header_size;
+    uint32_t struct_size[CHECKPOINT_SECTIONS];
+    uint32_t size;
+    uint32_t banks;
+    uint32_t accounts;
+    uint32_t rentiers;
+    uint32_t tick_mode;
+    uint32_t simd;
+    uint32_t threads;
+    uint32_t tick;
+    uint32_t bankruptcies;
+    uint64_t seed;
+    uint64_t offset[CHECKPOINT_SECTIONS];
+    uint64_t length[CHECKPOINT_SECTIONS];
+    uint64_t file_size;
+    Params params;
+    Merchant merchant;
+    State state[MAX_LOCATIONS];
+} Checkpoint;
+
+static const uint32_t checkpoint_struct_size[CHECKPOINT_SECTIONS] = {
+    sizeof(Firm), sizeof(Bank), sizeof(Account), sizeof(Rentier)
+};
+
+static uint64_t checkpoint_align(uint64_t offset)
+{
+    return (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+/* writes zeros up to the given offset */
+static int checkpoint_pad(FILE * fp, uint64_t * position, uint64_t offset)
+{
+    static const char zeros[CHECKPOINT_ALIGN];
+    size_t n;
+
+    while (*position < offset) {
+        n = sizeof(zeros);
+        if (offset - *position < n) n = (size_t)(offset - *position);
+        if (fwrite(zeros, 1, n, fp) != n) return -1;
+        *position += n;
+    }
+    return 0;
+}
+
+static int checkpoint_write(FILE * fp, uint64_t * position, const void * data, uint64_t length)
+{
+    if ((length > 0) && (fwrite(data, 1, (size_t)length, fp) != (size_t)length)) return -1;
+    *position += length;
+    return 0;
+}
+
+/* saves the state of the economy to the given file. Returns zero on success */
+int econ_save(Economy * e, const char * filename)
+{
+    Checkpoint c;
+    FILE * fp;
+    unsigned int i;
+    uint64_t position = 0;
+    int retval = 0;
+
+    memset(&c, '\0', sizeof(c));
+    memcpy(c.magic, CHECKPOINT_MAGIC, sizeof(c.magic));
+    c.version = CHECKPOINT_VERSION;
+    c.endian = CHECKPOINT_ENDIAN;
+    c.header_size = sizeof(Checkpoint);
+    memcpy(c.struct_size, checkpoint_struct_size, sizeof(c.struct_size));
+    c.size = e->size;
+    c.banks = e->banks;
+    for (i = 0; i < e->banks; i++) {
+        c.accounts += e->bank[i].max_accounts;
+    }
+    c.rentiers = e->rentiers;
+    c.tick_mode = e->tick_mode;
+    c.simd = (uint32_t)e->simd;
+    c.threads = e->threads;
+    c.tick = e->tick;
+    c.bankruptcies = e->bankruptcies;
+    c.seed = e->seed;
+    c.params = e->params;
+    c.merchant = e->merchant;
+    memcpy(c.state, e->state, sizeof(c.state));
+
+    c.length[CHECKPOINT_FIRM] = (uint64_t)e->size * sizeof(Firm);
+    c.length[CHECKPOINT_BANK] = (uint64_t)e->banks * sizeof(Bank);
+    c.length[CHECKPOINT_ACCOUNT] = (uint64_t)c.accounts * sizeof(Account);
+    c.length[CHECKPOINT_RENTIER] = (uint64_t)e->rentiers * sizeof(Rentier);
+    position = sizeof(Checkpoint);
+    for (i = 0; i < CHECKPOINT_SECTIONS; i++) {
+        c.offset[i] = checkpoint_align(position);
+        position = c.offset[i] + c.length[i];
+    }
+    c.file_size = position;
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL) return -1;
+
+    position = 0;
+    if ((checkpoint_write(fp, &position, &c, sizeof(c)) != 0) ||
+        (checkpoint_pad(fp, &position, c.offset[CHECKPOINT_FIRM]) != 0) ||
+        (checkpoint_write(fp, &position, e->firm, c.length[CHECKPOINT_FIRM]) != 0) ||
+        (checkpoint_pad(fp, &position, c.offset[CHECKPOINT_BANK]) != 0) ||
+        (checkpoint_write(fp, &position, e->bank, c.length[CHECKPOINT_BANK]) != 0) ||
+        (checkpoint_pad(fp, &position, c.offset[CHECKPOINT_ACCOUNT]) != 0)) {
+        retval = -1;
+    }
+    for (i = 0; (retval == 0) && (i < e->banks); i++) {
+        retval = checkpoint_write(fp, &position, e->bank[i].account,
+                                  (uint64_t)e->bank[i].max_accounts * sizeof(Account));
+    }
+    if ((retval == 0) &&
+        ((checkpoint_pad(fp, &position, c.offset[CHECKPOINT_RENTIER]) != 0) ||
+         (checkpoint_write(fp, &position, e->rentier, c.length[CHECKPOINT_RENTIER]) != 0))) {
+        retval = -1;
+    }
+    if (fclose(fp) != 0) retval = -1;
+    return retval;
+}
+
+/* returns non-zero if the header describes a checkpoint which can be
+   used by this build and which fits within the mapped file */
+static int checkpoint_valid(Checkpoint * c, uint64_t file_size)
+{
+    unsigned int i;
+
+    if (memcmp(c->magic, CHECKPOINT_MAGIC, sizeof(c->magic)) != 0) return 0;
+    if (c->endian != CHECKPOINT_ENDIAN) {
+        fprintf(stderr, "Checkpoint was written with a different byte order\n");
+        return 0;
+    }
+    if ((c->version != CHECKPOINT_VERSION) ||
+        (c->header_size != sizeof(Checkpoint)) ||
+        (memcmp(c->struct_size, checkpoint_struct_size, sizeof(c->struct_size)) != 0)) {
+        fprintf(stderr, "Checkpoint was written by a different version\n");
+        return 0;
+    }
+    if ((c->file_size != file_size) || (c->size == 0) ||
+        (c->banks == 0) || (c->accounts == 0) ||
+        (c->tick_mode >= TICK_MODES)) return 0;
+    if ((c->length[CHECKPOINT_FIRM] != (uint64_t)c->size * sizeof(Firm)) ||
+        (c->length[CHECKPOINT_BANK] != (uint64_t)c->banks * sizeof(Bank)) ||
+        (c->length[CHECKPOINT_ACCOUNT] !=
+         (uint64_t)c->accounts * sizeof(Account)) ||
+        (c->length[CHECKPOINT_RENTIER] != (uint64_t)c->rentiers * sizeof(Rentier))) {
+        return 0;
+    }
+    for (i = 0; i < CHECKPOINT_SECTIONS; i++) {
+        if ((c->offset[i] % CHECKPOINT_ALIGN != 0) ||
+            (c->offset[i] < sizeof(Checkpoint)) ||
+            (c->offset[i] > file_size) ||
+            (c->length[i] > file_size - c->offset[i])) return 0;
+    }
+    return params_valid(&c->params);
+}
+
+/* follows the chain of accounts held by the same entity from an open
+   account. Every link must lead to another open account of the same
+   entity, and since an entity holds at most one account with each
+   bank a chain longer than the number of banks must contain a cycle */
+static int checkpoint_chain_valid(Economy * e, Account * a)
+{
+    AccountRef ref = a->next;
+    unsigned int steps = 0;
+    Account * held;
+
+    while (ref.bank != -1) {
+        if ((ref.bank < 0) || ((unsigned int)ref.bank >= e->banks) ||
+            (ref.slot < 0) ||
+            ((unsigned int)ref.slot >= e->bank[ref.bank].max_accounts) ||
+            (++steps > e->banks)) return 0;
+        held = &e->bank[ref.bank].account[ref.slot];
+        if ((held->entity_type != a->entity_type) ||
+            (held->entity_index != a->entity_index)) return 0;
+        ref = held->next;
+    }
+    return 1;
+}
+
+/* checks that the locations, product types and account holders which
+   are used as indices lie within the economy being loaded */
+static int checkpoint_entities_valid(Economy * e)
+{
+    unsigned int i, j;
+    Firm * f;
+    Account * a;
+
+    if (e->merchant.tax_location >= e->params.locations) return 0;
+    for (i = 0; i < e->size; i++) {
+        f = &e->firm[i];
+        if ((f->location >= e->params.locations) ||
+            (f->process.product_type >= MAX_PRODUCT_TYPES)) return 0;
+        for (j = 0; j < PROCESS_INPUTS; j++) {
+            if (f->process.raw_material[j] >= MAX_PRODUCT_TYPES) return 0;
+        }
+    }
+    for (i = 0; i < e->banks; i++) {
+        for (j = 0; j < e->bank[i].max_accounts; j++) {
+            a = &e->bank[i].account[j];
+            if (bank_account_defunct(a)) continue;
+            if ((bank_account_list(e, a->entity_type, a->entity_index) == NULL) ||
+                !checkpoint_chain_valid(e, a)) return 0;
+        }
+    }
+    return 1;
+}
+
+/* loads an economy from a checkpoint. Returns NULL on failure */
+Economy * econ_load(const char * filename)
+{
+    EconomyConfig config;
+    Checkpoint * c;
+    Economy * e;
+    Bank * bank;
+    Account * account;
+    struct stat st;
+    unsigned int i, accounts, total = 0;
+    char * base;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+    if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(Checkpoint))) {
+        close(fd);
+        return NULL;
+    }
+    base = (char*)mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    c = (Checkpoint*)base;
+    if (!checkpoint_valid(c, (uint64_t)st.st_size)) {
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+
+    econ_config_init(&config);
+    config.size = c->size;
+    config.banks = c->banks;
+    config.accounts = 2;
+    config.rentiers = c->rentiers;
+    config.tick_mode = c->tick_mode;
+    config.simd = (int)c->simd;
+    config.threads = c->threads;
+    config.seed = c->seed;
+    config.params = c->params;
+    e = econ_alloc(&config, 0);
+    if (e == NULL) {
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    e->mapping = base;
+    e->mapping_size = (size_t)st.st_size;
+
+    e->firm = (Firm*)(base + c->offset[CHECKPOINT_FIRM]);
+    if (e->rentiers > 0) {
+        e->rentier = (Rentier*)(base + c->offset[CHECKPOINT_RENTIER]);
+    }
+    e->tick = c->tick;
+    e->bankruptcies = c->bankruptcies;
+    e->merchant = c->merchant;
+    memcpy(e->state, c->state, sizeof(e->state));
+
+    /* accounts are copied, so that banks own their account arrays
+       and can grow them, and their schedules of loans are rebuilt */
+    bank = (Bank*)(base + c->offset[CHECKPOINT_BANK]);
+    account = (Account*)(base + c->offset[CHECKPOINT_ACCOUNT]);
+    for (i = 0; i < e->banks; i++) {
+        accounts = bank[i].max_accounts;
+        if ((accounts == 0) || (accounts > c->accounts - total) ||
+            (bank[i].free_account >= (int)accounts)) {
+            econ_destroy(e);
+            return NULL;
+        }
+        if (bank_restore(&e->bank[i], &bank[i], &account[total]) != 0) {
+            econ_destroy(e);
+            return NULL;
+        }
+        total += accounts;
+    }
+    if ((total != c->accounts) || !checkpoint_entities_valid(e)) {
+        econ_destroy(e);
+        return NULL;
+    }
+
+    bank_index_rebuild(e);
+    market_rebuild(e);
+    return e;
+}
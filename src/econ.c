@@ -29,88 +29,236 @@
 
 ****************************************************************/
 
+#include <sys/mman.h>
 #include "econ.h"
 
 void clear_history(Capital * c)
 {
-    memset(&c->surplus_history[0], '\0', HISTORY_STEPS*sizeof(float));
+    memset(&c->surplus_history[0], '\0', MAX_HISTORY_STEPS*sizeof(float));
 }
 
-void update_history(Capital * c)
+/* shifts the surplus history along by one, keeping the given number of steps */
+void update_history(Capital * c, unsigned int steps)
 {
     int i;
 
-    for (i = HISTORY_STEPS-2; i >= 0; i--) {
+    if (steps == 0) return;
+    for (i = (int)steps-2; i >= 0; i--) {
         c->surplus_history[i+1] = c->surplus_history[i];
     }
     c->surplus_history[0] = c->surplus;
 }
 
-void econ_init(Economy * e)
+void econ_config_init(EconomyConfig * config)
+{
+    config->size = DEFAULT_ECONOMY_SIZE;
+    config->banks = DEFAULT_BANKS;
+    config->accounts = 0;
+    config->rentiers = DEFAULT_RENTIERS;
+    config->tick_mode = TICK_SERIAL;
+    config->simd = 1;
+    config->threads = 1;
+    config->seed = 1;
+    params_init(&config->params);
+}
+
+static void econ_init_firms(void * arg, unsigned int start, unsigned int end)
+{
+    Economy * e = (Economy*)arg;
+    unsigned int i;
+    Rng rng;
+
+    for (i = start; i < end; i++) {
+        rng_init(&rng, e->seed, ENTITY_FIRM, i, e->tick);
+        firm_init(&e->firm[i], &e->params, &rng);
+    }
+}
+
+static void econ_init(Economy * e)
 {
     unsigned int i;
     Firm * f;
+    Rng rng;
 
-    e->size = MAX_ECONOMY_SIZE;
-    for (i = 0; i < LOCATIONS; i++) {
-        state_init(&e->state[i]);
+    e->tick = 0;
+    for (i = 0; i < e->params.locations; i++) {
+        rng_init(&rng, e->seed, ENTITY_STATE, i, e->tick);
+        state_init(&e->state[i], &e->params, &rng);
     }
     e->bankruptcies = 0;
+    parallel_for(e->threads, e->size, econ_init_firms, e);
     for (i = 0; i < e->size; i++) {
         f = &e->firm[i];
-        firm_init(f);
         e->state[f->location].population += e->firm[i].labour.workers;
     }
-    merchant_init(&e->merchant);
-    for (i = 0; i < MAX_BANKS; i++) {
-        bank_init(&e->bank[i]);
+    rng_init(&rng, e->seed, ENTITY_MERCHANT, 0, e->tick);
+    merchant_init(&e->merchant, &e->params, &rng);
+    for (i = 0; i < e->banks; i++) {
+        rng_init(&rng, e->seed, ENTITY_BANK, i, e->tick);
+        bank_init(&e->bank[i], &e->params, &rng);
     }
-    for (i = 0; i < MAX_RENTIERS; i++) {
-        rentier_init(&e->rentier[i]);
+    bank_index_rebuild(e);
+    for (i = 0; i < e->rentiers; i++) {
+        rng_init(&rng, e->seed, ENTITY_RENTIER, i, e->tick);
+        rentier_init(&e->rentier[i], &e->params, &rng);
     }
 }
 
-float econ_average_price(Economy * e, unsigned int product_type, unsigned int location)
+/* allocates an economy on the heap with the sizes given in the config,
+   without initialising it. The number of accounts per bank is only the
+   initial number of slots, which grow as loans are issued, and if zero
+   defaults to a quarter of the number of firms. The firm and
+   rentier arrays are only allocated if entities is non-zero, otherwise
+   they are left for the caller to provide */
+Economy * econ_alloc(EconomyConfig * config, int entities)
 {
-    unsigned int i,hits=0;
-    Firm * f;
-    float average = 0;
+    unsigned int i, accounts = config->accounts;
+    Economy * e;
+
+    if ((config->size == 0) || (config->banks == 0) ||
+        (config->tick_mode >= TICK_MODES) ||
+        (!params_valid(&config->params))) return NULL;
+    if (accounts == 0) accounts = config->size/4;
+    if (accounts < 2) accounts = 2;
+
+    e = (Economy*)calloc(1, sizeof(Economy));
+    if (e == NULL) return NULL;
+
+    e->size = config->size;
+    e->banks = config->banks;
+    e->rentiers = config->rentiers;
+    e->tick_mode = config->tick_mode;
+    e->simd = config->simd;
+    e->threads = (config->threads > 0) ? config->threads : 1;
+    e->seed = config->seed;
+    e->params = config->params;
+    e->bank = (Bank*)calloc(e->banks, sizeof(Bank));
+    if (entities != 0) {
+        e->firm = (Firm*)malloc(e->size*sizeof(Firm));
+        if (e->rentiers > 0) {
+            e->rentier = (Rentier*)malloc(e->rentiers*sizeof(Rentier));
+        }
+        if ((e->firm == NULL) ||
+            ((e->rentiers > 0) && (e->rentier == NULL))) {
+            econ_destroy(e);
+            return NULL;
+        }
+    }
+    if (e->bank == NULL) {
+        econ_destroy(e);
+        return NULL;
+    }
+    for (i = 0; i < e->banks; i++) {
+        if (bank_alloc(&e->bank[i], accounts) != 0) {
+            econ_destroy(e);
+            return NULL;
+        }
+    }
 
+    if ((bank_index_init(e) != 0) ||
+        (market_init(&e->market, e->size, e->params.locations) != 0) ||
+        (treap_init(&e->mergers, e->size) != 0) ||
+        (tournament_init(&e->wages, e->size) != 0) ||
+        (firm_store_init(&e->store, e->size, &e->params) != 0)) {
+        econ_destroy(e);
+        return NULL;
+    }
+    e->recruit_position = (int*)malloc(e->size*sizeof(int));
+    e->orders = (FirmOrder*)calloc(e->size, sizeof(FirmOrder));
+    e->restarts = (unsigned int*)malloc(e->size*sizeof(unsigned int));
+    if ((e->recruit_position == NULL) || (e->orders == NULL) ||
+        (e->restarts == NULL)) {
+        econ_destroy(e);
+        return NULL;
+    }
     for (i = 0; i < e->size; i++) {
-        f = &e->firm[i];
-        if (firm_defunct(f)) continue;
-        if ((f->process.product_type == product_type) &&
-            (f->process.stock > 0) &&
-            (f->location == location)) {
-            average += f->sale_value*f->process.stock;
-            hits += f->process.stock;
+        e->recruit_position[i] = -1;
+    }
+    /* any firm may be recruiting, so each location's queue is given
+       room for all of them and hiring never needs to allocate */
+    for (i = 0; i < MAX_LOCATIONS; i++) {
+        heap_init(&e->recruits[i]);
+    }
+    for (i = 0; i < e->params.locations; i++) {
+        if (heap_reserve(&e->recruits[i], e->size) != 0) {
+            econ_destroy(e);
+            return NULL;
+        }
+    }
+    return e;
+}
+
+/* allocates and initialises an economy with the sizes given in the config */
+Economy * econ_create(EconomyConfig * config)
+{
+    Economy * e = econ_alloc(config, 1);
+
+    if (e == NULL) return NULL;
+    econ_init(e);
+    market_rebuild(e);
+    return e;
+}
+
+void econ_destroy(Economy * e)
+{
+    unsigned int i;
+
+    if (e == NULL) return;
+    if (e->bank != NULL) {
+        for (i = 0; i < e->banks; i++) {
+            bank_free(&e->bank[i]);
         }
     }
+    bank_index_free(e);
+    market_free(&e->market);
+    treap_free(&e->mergers);
+    tournament_free(&e->wages);
+    firm_store_free(&e->store);
+    for (i = 0; i < MAX_LOCATIONS; i++) {
+        heap_free(&e->recruits[i]);
+    }
+    free(e->recruit_position);
+    free(e->orders);
+    free(e->restarts);
+    free(e->bank);
+#ifdef ECON_PROFILE
+    profile_perf_close(&e->profile);
+#endif
+
+    /* firms and rentiers may be held within a mapped checkpoint */
+    if (e->mapping != NULL) {
+        munmap(e->mapping, e->mapping_size);
+    }
+    else {
+        free(e->firm);
+        free(e->rentier);
+    }
+    free(e);
+}
+
+float econ_average_price(Economy * e, unsigned int product_type, unsigned int location)
+{
+    double average = e->market.value[product_type][location];
+    double hits = e->market.stock[product_type][location];
 
     average += e->merchant.price[product_type] * e->merchant.stock[product_type];
-    hits += e->merchant.stock[product_type];
+    hits += floorf(e->merchant.stock[product_type]);
 
-    if (hits > 0) return average / (float)hits;
+    if (hits > 0) return (float)(average / hits);
     return 0;
 }
 
 float econ_average_price_global(Economy * e, unsigned int product_type)
 {
-    unsigned int i,hits=0;
-    Firm * f;
-    float average = 0;
+    unsigned int l;
+    double average = 0, hits = 0;
 
-    for (i = 0; i < e->size; i++) {
-        f = &e->firm[i];
-        if (firm_defunct(f)) continue;
-        if ((f->process.product_type == product_type) &&
-            (f->process.stock > 0)) {
-            average += f->sale_value*f->process.stock;
-            hits += f->process.stock;
-        }
+    for (l = 0; l < e->params.locations; l++) {
+        average += e->market.value[product_type][l];
+        hits += e->market.stock[product_type][l];
     }
 
-    if (hits > 0) return average / (float)hits;
+    if (hits > 0) return (float)(average / hits);
     return 0;
 }
 
@@ -121,6 +269,7 @@ float econ_average_price_variance(Economy * e, unsigned int product_type)
     float average = econ_average_price_global(e, product_type);
     float variance = 0;
 
+    PROFILE_SCAN(e);
     for (i = 0; i < e->size; i++) {
         f = &e->firm[i];
         if (firm_defunct(f)) continue;
@@ -141,6 +290,7 @@ float econ_average_wage(Economy * e, unsigned int location)
     Firm * f;
     float average = 0;
 
+    PROFILE_SCAN(e);
     for (i = 0; i < e->size; i++) {
         f = &e->firm[i];
         if (firm_defunct(f)) continue;
@@ -153,79 +303,133 @@ float econ_average_wage(Economy * e, unsigned int location)
     return 0;
 }
 
-void econ_startups(Economy * e)
+static void econ_restart_firms(void * arg, unsigned int start, unsigned int end)
 {
+    Economy * e = (Economy*)arg;
     unsigned int i;
+    Rng rng;
+
+    for (i = start; i < end; i++) {
+        rng_init(&rng, e->seed, ENTITY_FIRM, e->restarts[i], e->tick);
+        firm_init(&e->firm[e->restarts[i]], &e->params, &rng);
+    }
+}
+
+/* Defunct firms are replaced by new ones, staffed from the unemployed.
+   The new firms are initialised concurrently, and then staffed in order
+   of firm index */
+void econ_startups(Economy * e)
+{
+    unsigned int i, restarts = 0;
     Firm * f;
     Bank * b;
+    Rng rng;
 
+    PROFILE_SCAN(e);
     for (i = 0; i < e->size; i++) {
-        f = &e->firm[i];
-        if (firm_defunct(f)) {
-            firm_init(f);
-            if (e->state[f->location].unemployed >= INITIAL_WORKERS) {
-                e->state[f->location].unemployed -= f->labour.workers;
-                if (e->bankruptcies > 0) e->bankruptcies--;
-            }
-            else {
-                f->labour.workers = 0;
-            }
+        if (firm_defunct(&e->firm[i])) {
+            e->restarts[restarts++] = i;
+        }
+    }
+    parallel_for(e->threads, restarts, econ_restart_firms, e);
+
+    for (i = 0; i < restarts; i++) {
+        f = &e->firm[e->restarts[i]];
+        if (e->state[f->location].unemployed >= e->params.initial_workers) {
+            e->state[f->location].unemployed -= f->labour.workers;
+            if (e->bankruptcies > 0) e->bankruptcies--;
         }
+        else {
+            f->labour.workers = 0;
+        }
+        market_update(e, e->restarts[i]);
     }
 
-    for (i = 0; i < MAX_BANKS; i++) {
+    for (i = 0; i < e->banks; i++) {
         b = &e->bank[i];
         if (bank_defunct(b)) {
-            bank_init(b);
+            rng_init(&rng, e->seed, ENTITY_BANK, i, e->tick);
+            bank_index_remove(b, e);
+            bank_init(b, &e->params, &rng);
             if (e->bankruptcies > 0) e->bankruptcies--;
         }
     }
 }
 
+/* Each firm in turn acquires the most valuable firm in the same location
+   which it can afford and whose workforce it can absorb. Live firms are
+   held in a tree per location ordered by worth, so that the best target
+   can be found without comparing every pair of firms. The initial worth
+   of every firm is taken from the daily running costs in the firm store,
+   added in the same order as firm_worth */
 void econ_mergers(Economy * e)
 {
-    unsigned int i, j;
-    int best_index;
+    unsigned int i, l, headroom;
+    unsigned int max_workers = e->params.max_workers;
+    int best_index, root[MAX_LOCATIONS];
     Firm * f, * f2;
+    Treap * t = &e->mergers;
+    FirmStore * s = &e->store;
     float best;
 
+    for (l = 0; l < e->params.locations; l++) {
+        root[l] = -1;
+    }
+    firm_store_load(s, e, 0, e->size);
+    firm_store_daily(s, 0, e->size);
+    PROFILE_SCAN(e);
     for (i = 0; i < e->size; i++) {
         f = &e->firm[i];
         if (firm_defunct(f)) continue;
+        root[f->location] =
+            treap_insert(t, root[f->location], i,
+                         working_capital(&f->capital) + s->wages_per_day[i] +
+                         s->fixed_per_day[i], f->labour.workers);
+    }
+
+    PROFILE_SCAN(e);
+    for (i = 0; i < e->size; i++) {
+        f = &e->firm[i];
+        if (firm_defunct(f)) continue;
+        l = f->location;
+
+        /* a firm cannot acquire itself */
+        root[l] = treap_remove(t, root[l], i);
+
         best_index = -1;
-        best = 0;
-        for (j = 0; j < e->size; j++) {
-            if (i == j) continue;
-            f2 = &e->firm[j];
-            if (f2->labour.workers == 0) continue;
-            if (f2->location != f->location) continue;
-            if (f->capital.surplus > firm_worth(f2)) {
-                if (f->labour.workers + f2->labour.workers < MAX_WORKERS) {
-                    if (firm_worth(f2) > best) {
-                        best_index = (int)j;
-                        best = firm_worth(f2);
-                    }
-                }
-            }
+        if (f->labour.workers < max_workers) {
+            headroom = max_workers - f->labour.workers;
+            best_index = treap_find(t, &root[l], f->capital.surplus, headroom);
         }
-        if (best_index > -1) {
+        if ((best_index > -1) && (t->key[best_index] > 0)) {
             f2 = &e->firm[best_index];
+            best = t->key[best_index];
+            root[l] = treap_remove(t, root[l], (unsigned int)best_index);
             f->capital.surplus -= best;
             f->labour.workers += f2->labour.workers;
             f2->labour.workers = 0;
+            market_update(e, (unsigned int)best_index);
+            PROFILE_COUNT(e, COUNT_MERGERS, 1);
         }
+
+        root[l] = treap_insert(t, root[l], i, firm_worth(f), f->labour.workers);
     }
 }
 
 void econ_close_bank_account(Economy * e, unsigned int entity_type, unsigned int entity_index)
 {
-    unsigned int i;
+    AccountRef * list = bank_account_list(e, entity_type, entity_index);
+    AccountRef ref, next;
     Bank * b;
 
-    for (i = 0; i < MAX_BANKS; i++) {
-        b = &e->bank[i];
+    /* only the banks with which the entity holds accounts are visited */
+    if (list == NULL) return;
+    for (ref = *list; ref.bank >= 0; ref = next) {
+        PROFILE_COUNT(e, COUNT_ACCOUNT_PROBES, 1);
+        b = &e->bank[ref.bank];
+        next = b->account[ref.slot].next;
         if (bank_defunct(b)) continue;
-        bank_account_close_entity(b, e, entity_type, entity_index);
+        bank_account_close(b, e, (unsigned int)ref.slot);
     }
 }
 
@@ -234,6 +438,7 @@ void econ_bankrupt(Economy * e)
     unsigned int i;
     Firm * f;
 
+    PROFILE_SCAN(e);
     for (i = 0; i < e->size; i++) {
         f = &e->firm[i];
         if (firm_defunct(f)) continue;
@@ -243,149 +448,370 @@ void econ_bankrupt(Economy * e)
             }
             e->state[f->location].unemployed += f->labour.workers;
             f->labour.workers = 0;
+            market_update(e, i);
             e->bankruptcies++;
         }
     }
 }
 
+/* wage offered by a firm which is able to take on another worker */
+static float econ_vacancy_wage(Economy * e, Firm * f)
+{
+    if ((f->labour.workers == 0) ||
+        (f->labour.workers >= e->params.max_workers-1)) {
+        return -INFINITY;
+    }
+    return f->labour.wage_rate;
+}
+
 void econ_labour_market(Economy * e)
 {
-    unsigned int i, j, l, max, recruiting=0;
-    int best;
+    unsigned int i, l;
+    int best, best_other;
     Firm * f, * f2;
-    float max_wage;
+    Tournament * t = &e->wages;
+
+    /* workers can move between firms, going to whichever other
+       firm offers the highest wage */
+    PROFILE_SCAN(e);
+    for (i = 0; i < e->size; i++) {
+        t->key[i] = econ_vacancy_wage(e, &e->firm[i]);
+    }
+    tournament_build(t);
 
-    /* workers can move between firms */
+    PROFILE_SCAN(e);
     for (i = 0; i < e->size; i++) {
         f = &e->firm[i];
         if (firm_defunct(f)) continue;
-        max_wage = f->labour.wage_rate;
-        best = -1;
-        for (j = 0; j < e->size; j++) {
-            if (i == j) continue;
-            f2 = &e->firm[j];
-            if (f2->labour.workers == 0) continue;
-
-            if ((f2->labour.wage_rate > max_wage) &&
-                (f2->labour.workers < MAX_WORKERS-1)) {
-                max_wage = f2->labour.wage_rate;
-                best = (int)j;
-            }
+        best = tournament_best(t, 0, i);
+        best_other = tournament_best(t, i+1, e->size);
+        if ((best_other > -1) &&
+            ((best == -1) || (t->key[best_other] > t->key[best]))) {
+            best = best_other;
         }
-        if (best > -1) {
+        if ((best > -1) && (t->key[best] > f->labour.wage_rate)) {
             f2 = &e->firm[best];
             f->labour.workers--;
             f2->labour.workers++;
             f2->labour.is_recruiting = 0;
+            tournament_set(t, i, econ_vacancy_wage(e, f));
+            tournament_set(t, (unsigned int)best, econ_vacancy_wage(e, f2));
+            market_update(e, i);
         }
     }
 
-    /* unemployed may be recruited */
+    /* unemployed may be recruited, each going to whichever recruiting
+       firm in their location offers the highest wage */
+    PROFILE_SCAN(e);
     for (i = 0; i < e->size; i++) {
         f = &e->firm[i];
         if (firm_defunct(f)) continue;
-        if (f->labour.is_recruiting == 1) recruiting++;
-    }
-    if (recruiting > 0) {
-        for (l = 0; l < LOCATIONS; l++) {
-            max = e->state[l].unemployed;
-            for (i = 0; i < max; i++) {
-                max_wage = 0;
-                best = -1;
-                for (j = 0; j < e->size; j++) {
-                    f = &e->firm[i];
-                    if (firm_defunct(f)) continue;
-                    if (f->location != l) continue;
-                    if (f->labour.is_recruiting == 0) continue;
-                    if (f->labour.wage_rate > max_wage) {
-                        max_wage = f->labour.wage_rate;
-                        best = (int)j;
-                    }
-                }
-                if (best > -1) {
-                    f = &e->firm[best];
-                    f->labour.workers++;
-                    f->labour.is_recruiting = 0;
-                    recruiting--;
-                    e->state[l].unemployed--;
-                    printf("e->state[l].unemployed %d\n",(int)e->state[l].unemployed);
-                }
-                if (recruiting == 0) break;
-            }
+        if (f->labour.is_recruiting == 0) continue;
+        /* each queue has room for every firm, so this cannot fail */
+        heap_insert(&e->recruits[f->location], e->recruit_position,
+                    i, -f->labour.wage_rate);
+    }
+    for (l = 0; l < e->params.locations; l++) {
+        while ((e->state[l].unemployed > 0) &&
+               ((best = heap_top(&e->recruits[l])) > -1)) {
+            heap_remove(&e->recruits[l], e->recruit_position, (unsigned int)best);
+            f = &e->firm[best];
+            f->labour.workers++;
+            f->labour.is_recruiting = 0;
+            e->state[l].unemployed--;
+            PROFILE_COUNT(e, COUNT_HIRES, 1);
         }
+        heap_clear(&e->recruits[l], e->recruit_position);
     }
 }
 
 /* returns the index of the firm with the best offering price for a commodity */
 int econ_best_price(Economy * e, Firm * f, unsigned int product_type, unsigned int local)
 {
-    unsigned int i;
-    int best_index = -1;
-    Firm * f2;
+    unsigned int l, self = e->size;
+    int index, best_index = -1;
     float best = 0;
 
-    for (i = 0; i < e->size; i++) {
-        f2 = &e->firm[i];
-        if (firm_defunct(f2)) continue;
-        if (f != NULL) {
-            if (f2 == f) continue;
-            if ((local != 0) && (f2->location != f->location)) continue;
-        }
-        if ((f2->process.product_type == product_type) &&
-            (f2->process.stock > 0)) {
-            if ((best_index == -1) || (f2->sale_value < best)) {
-                best = f2->sale_value;
-                best_index = i;
-            }
+    PROFILE_COUNT(e, COUNT_BEST_PRICE, 1);
+    if (f != NULL) self = (unsigned int)firm_index(f, e);
+    for (l = 0; l < e->params.locations; l++) {
+        if ((f != NULL) && (local != 0) && (l != f->location)) continue;
+        index = heap_top_excluding(&e->market.book[product_type][l], self);
+        if (index == -1) continue;
+        if ((best_index == -1) || (e->firm[index].sale_value < best) ||
+            ((e->firm[index].sale_value == best) && (index < best_index))) {
+            best = e->firm[index].sale_value;
+            best_index = index;
         }
     }
     return best_index;
 }
 
-void econ_update(Economy * e, unsigned int weeks)
+/* Updates firms in three phases: all firms make their purchases, then
+   production for every firm is accounted for in a single batch pass
+   over the firm store, and finally each firm reviews its strategy */
+static void econ_firms_phased(Economy * e, unsigned int weeks)
 {
     unsigned int i;
     Firm * f;
 
-    econ_startups(e);
     for (i = 0; i < e->size; i++) {
         f = &e->firm[i];
         if (firm_defunct(f)) continue;
-        firm_update(f, e, weeks);
+        firm_purchasing(f, e, weeks);
+    }
+
+    firm_store_load(&e->store, e, 0, e->size);
+    firm_store_production(&e->store, weeks, 0, e->size, e->simd);
+    firm_store_save(&e->store, e, 0, e->size);
+    firm_store_daily(&e->store, 0, e->size);
+
+    for (i = 0; i < e->size; i++) {
+        f = &e->firm[i];
+        if (firm_defunct(f)) continue;
+        market_update(e, i);
+        firm_strategy(f, e, e->store.surplus_per_day[i], NULL);
+        market_update(e, i);
+        update_history(&f->capital, e->params.history_steps);
+    }
+}
+
+typedef struct
+{
+    Economy * e;
+    unsigned int weeks;
+} EconTask;
+
+static void econ_orders_range(void * arg, unsigned int start, unsigned int end)
+{
+    EconTask * task = (EconTask*)arg;
+    Economy * e = task->e;
+    unsigned int i;
+    Firm * f;
+
+    for (i = start; i < end; i++) {
+        f = &e->firm[i];
+        if (firm_defunct(f)) continue;
+        e->orders[i].loan = 0;
+        e->orders[i].loan_bank = -1;
+        e->orders[i].laid_off = 0;
+        firm_orders(f, &e->params, task->weeks, &e->orders[i]);
+    }
+}
+
+static void econ_production_range(void * arg, unsigned int start, unsigned int end)
+{
+    EconTask * task = (EconTask*)arg;
+    Economy * e = task->e;
+
+    firm_store_load(&e->store, e, start, end);
+    firm_store_production(&e->store, task->weeks, start, end, e->simd);
+    firm_store_save(&e->store, e, start, end);
+    firm_store_daily(&e->store, start, end);
+}
+
+static void econ_strategy_range(void * arg, unsigned int start, unsigned int end)
+{
+    EconTask * task = (EconTask*)arg;
+    Economy * e = task->e;
+    unsigned int i;
+    Firm * f;
+
+    for (i = start; i < end; i++) {
+        f = &e->firm[i];
+        if (firm_defunct(f)) continue;
+        firm_strategy(f, e, e->store.surplus_per_day[i], &e->orders[i]);
+        update_history(&f->capital, e->params.history_steps);
+    }
+}
+
+/* Updates firms concurrently. Work which only alters a firm's own state
+   (ordering, production and strategy) is shared between threads, with
+   strategies reviewed against a snapshot of the market. Anything which
+   alters other entities (purchases from suppliers and the merchant,
+   loans and layoffs) is settled on a single thread in order of firm
+   index, so the results do not depend upon the number of threads */
+static void econ_firms_parallel(Economy * e, unsigned int weeks)
+{
+    unsigned int i;
+    Firm * f;
+    FirmOrder * order;
+    EconTask task;
+
+    task.e = e;
+    task.weeks = weeks;
+
+    parallel_for(e->threads, e->size, econ_orders_range, &task);
+    for (i = 0; i < e->size; i++) {
+        f = &e->firm[i];
+        if (firm_defunct(f)) continue;
+        firm_settle_orders(f, e, weeks, &e->orders[i]);
+    }
+
+    parallel_for(e->threads, e->size, econ_production_range, &task);
+    for (i = 0; i < e->size; i++) {
+        market_update(e, i);
+    }
+
+    parallel_for(e->threads, e->size, econ_strategy_range, &task);
+    for (i = 0; i < e->size; i++) {
+        f = &e->firm[i];
+        if (firm_defunct(f)) continue;
+        order = &e->orders[i];
+        firm_obtain_loan(f, e, order->loan_bank, order->loan);
+        e->state[f->location].unemployed += order->laid_off;
+        market_update(e, i);
+    }
+}
+
+static void econ_firms(Economy * e, unsigned int weeks)
+{
+    unsigned int i;
+    Firm * f;
+
+    if (e->tick_mode == TICK_PHASED) {
+        econ_firms_phased(e, weeks);
+        return;
     }
-    for (i = 0; i < MAX_BANKS; i++) {
-        bank_update(&e->bank[i], e, weeks * 5);
+    if (e->tick_mode == TICK_PARALLEL) {
+        econ_firms_parallel(e, weeks);
+        return;
     }
-    for (i = 0; i < LOCATIONS; i++) {
-        state_update(&e->state[i], e, weeks);
+
+    for (i = 0; i < e->size; i++) {
+        f = &e->firm[i];
+        if (firm_defunct(f)) continue;
+        firm_update(f, e, weeks);
     }
-    merchant_update(e);
-    econ_bankrupt(e);
-    econ_mergers(e);
-    econ_labour_market(e);
 }
 
-int main(int argc, char* argv[])
+const char * econ_phase_name(unsigned int phase)
 {
-    Economy e;
-    unsigned int i, j;
+    const char * names[] = {
+        "market", "startups", "firms", "banks", "states",
+        "merchant", "bankrupt", "mergers", "labour"
+    };
 
-    econ_init(&e);
+    if (phase >= PHASES) return "unknown";
+    return names[phase];
+}
+
+/* runs one phase of a tick */
+static void econ_update_phase(Economy * e, unsigned int phase, unsigned int weeks)
+{
+    unsigned int i;
 
-    for (i = 0; i < 100; i++)  {
-        econ_update(&e, 1);
-        printf("Profit: %.2f\n",e.firm[0].capital.surplus);
-        printf("Bankrupt: %d/%d\n",e.bankruptcies,e.size);
-        printf("Unemployed: %d/%d\n",(int)e.state[0].unemployed,e.state[0].population);
-        printf("Merchant: ");
-        for (j = 0; j < MAX_PRODUCT_TYPES; j++)  {
-            printf("%d ", (int)e.merchant.stock[j]);
+    switch (phase) {
+    case PHASE_MARKET:
+        market_rebuild(e);
+        break;
+    case PHASE_STARTUPS:
+        econ_startups(e);
+        break;
+    case PHASE_FIRMS:
+        econ_firms(e, weeks);
+        break;
+    case PHASE_BANKS:
+        bank_averages_update(e);
+        for (i = 0; i < e->banks; i++) {
+            bank_update(&e->bank[i], e, weeks * 5);
         }
-        printf("\nBank: ");
-        for (j = 0; j < MAX_BANKS; j++)  {
-            printf("%.2f ", bank_worth(&e.bank[j]));
+        break;
+    case PHASE_STATES:
+        for (i = 0; i < e->params.locations; i++) {
+            state_update(&e->state[i], e, weeks);
         }
-        printf("\n");
+        break;
+    case PHASE_MERCHANT:
+        merchant_update(e);
+        break;
+    case PHASE_BANKRUPT:
+        econ_bankrupt(e);
+        break;
+    case PHASE_MERGERS:
+        econ_mergers(e);
+        break;
+    case PHASE_LABOUR:
+        econ_labour_market(e);
+        break;
     }
+}
+
+/* Runs one phase of a tick, together with the tick count, profiling
+   and hashing which go with it. A tick consists of a step for each
+   phase in turn, so economies may be run side by side a phase at a
+   time exactly as they would be ticked */
+void econ_step(Economy * e, unsigned int phase, unsigned int weeks)
+{
+#ifdef ECON_PROFILE
+    uint64_t sample[1 + PERF_EVENTS];
+#endif
+
+    if (phase == 0) e->tick++;
+#ifdef ECON_PROFILE
+    profile_begin(&e->profile, sample);
+#endif
+    econ_update_phase(e, phase, weeks);
+#ifdef ECON_PROFILE
+    profile_end(&e->profile, phase, sample);
+#endif
+    if (e->hash_bits > 0) econ_hash_phase(e, phase);
+#ifdef ECON_PROFILE
+    if (phase == PHASES - 1) profile_tick(&e->profile);
+#endif
+}
+
+void econ_update(Economy * e, unsigned int weeks)
+{
+    unsigned int phase;
+
+    for (phase = 0; phase < PHASES; phase++) {
+        econ_step(e, phase, weeks);
+    }
+}
+
+/* changes the parameters of an existing economy. Those which fix the
+   sizes of its structures cannot be changed. Returns zero on success */
+int econ_set_params(Economy * e, Params * params)
+{
+    if ((!params_valid(params)) ||
+        (params->locations != e->params.locations)) return -1;
+    e->params = *params;
+    e->store.initial_workers = (float)params->initial_workers;
     return 0;
 }
+
+/* records the aggregates used to compare the outcomes of runs */
+void econ_summary(Economy * e, double * summary)
+{
+    unsigned int i;
+    double worth = 0;
+
+    summary[SUMMARY_BANKRUPTCIES] = e->bankruptcies;
+    summary[SUMMARY_UNEMPLOYED] = 0;
+    summary[SUMMARY_POPULATION] = 0;
+    for (i = 0; i < e->params.locations; i++) {
+        summary[SUMMARY_UNEMPLOYED] += e->state[i].unemployed;
+        summary[SUMMARY_POPULATION] += e->state[i].population;
+    }
+    summary[SUMMARY_MERCHANT_STOCK] = 0;
+    for (i = 0; i < MAX_PRODUCT_TYPES; i++) {
+        summary[SUMMARY_MERCHANT_STOCK] += e->merchant.stock[i];
+        summary[SUMMARY_PRICES + i] = econ_average_price_global(e, i);
+    }
+    for (i = 0; i < e->banks; i++) {
+        worth += bank_worth(&e->bank[i]);
+    }
+    summary[SUMMARY_BANK_WORTH] = worth / e->banks;
+}
+
+/* writes the CSV column names for the summary, each preceded by a comma */
+void econ_summary_header(FILE * fp)
+{
+    unsigned int i;
+
+    fprintf(fp, ",bankruptcies,unemployed,population,merchant_stock,bank_worth");
+    for (i = 0; i < MAX_PRODUCT_TYPES; i++) {
+        fprintf(fp, ",price_%u", i);
+    }
+}
@@ -32,7 +32,13 @@
 #ifndef ECON_H
 #define ECON_H
 
-#define MAX_ECONOMY_SIZE         1024
+/* default sizes, which may be overridden at runtime via EconomyConfig */
+#define DEFAULT_ECONOMY_SIZE     1024
+#define DEFAULT_BANKS            5
+#define DEFAULT_RENTIERS         1024
+
+/* The following behavioural values are the defaults for the runtime
+   parameters held within Params, and may be changed without recompiling */
 
 #define LABOUR_TIME_TOTAL        0
 #define LABOUR_TIME_NECESSARY    1
@@ -63,20 +69,30 @@
 #define INITIAL_STATE_DEPOSIT    (INITIAL_BANK_DEPOSIT*10)
 
 #define MAX_MERCHANT_STOCK       100000
-#define MAX_BANKS                5
-#define MAX_ACCOUNTS             (MAX_ECONOMY_SIZE/4)
+#define DEFAULT_ACCOUNTS         (DEFAULT_ECONOMY_SIZE/4)
 #define MIN_BANK_INTEREST        0
 #define MAX_BANK_INTEREST        30
 #define MIN_LOAN_INTEREST        0
+#define LOAN_REPAYMENT_DAYS      (30*6)
 #define MAX_LOAN_INTEREST        30
 
 #define MIN_SAVINGS_RATE         0
 #define MAX_SAVINGS_RATE         10
 
 #define HISTORY_STEPS            10
+#define MAX_HISTORY_STEPS        32
+
+/* slots in each level of a timer wheel, and the number of levels */
+#define WHEEL_BITS               6
+#define WHEEL_SLOTS              (1 << WHEEL_BITS)
+#define WHEEL_LEVELS             3
+
+/* smallest number of items worth handing to a thread */
+#define PARALLEL_MIN_CHUNK       1024
 
 /* number of locations/continents */
 #define LOCATIONS                3
+#define MAX_LOCATIONS            16
 
 #define MIN_VAT_RATE             0
 #define MAX_VAT_RATE             50
@@ -89,10 +105,15 @@
 #define MIN_CITIZENS_DIVIDEND    0
 #define MAX_CITIZENS_DIVIDEND    MAX_WAGE
 
-#define MAX_RENTIERS             1024
 #define INITIAL_RENTIER_DEPOSIT  10000
 
+/* significant bits kept when hashing floats, which for single
+   precision values is all of them */
+#define HASH_BITS                24
+#define MAX_HASH_BITS            53
+
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
@@ -103,9 +124,43 @@ enum {
     ENTITY_MERCHANT,
     ENTITY_BANK,
     ENTITY_STATE,
+    ENTITY_RENTIER,
     ENTITIES
 };
 
+/* phases of a tick, in the order in which they are run */
+enum {
+    PHASE_MARKET,
+    PHASE_STARTUPS,
+    PHASE_FIRMS,
+    PHASE_BANKS,
+    PHASE_STATES,
+    PHASE_MERCHANT,
+    PHASE_BANKRUPT,
+    PHASE_MERGERS,
+    PHASE_LABOUR,
+    PHASES
+};
+
+/* final aggregates used to compare runs */
+enum {
+    SUMMARY_BANKRUPTCIES,
+    SUMMARY_UNEMPLOYED,
+    SUMMARY_POPULATION,
+    SUMMARY_MERCHANT_STOCK,
+    SUMMARY_BANK_WORTH,
+    SUMMARY_PRICES,
+    SUMMARY_FIELDS = SUMMARY_PRICES + MAX_PRODUCT_TYPES
+};
+
+/* ways in which firms may be updated during a tick */
+enum {
+    TICK_SERIAL,
+    TICK_PHASED,
+    TICK_PARALLEL,
+    TICK_MODES
+};
+
 enum {
     ASSET_LAND,
     ASSET_HOUSE,
@@ -118,7 +173,7 @@ typedef struct
     float repayment_per_month;
     float variable, constant;
     float surplus, fictitious;
-    float surplus_history[HISTORY_STEPS];
+    float surplus_history[MAX_HISTORY_STEPS];
     float savings_rate;
 } Capital;
 
@@ -141,6 +196,88 @@ typedef struct
     float stock;
 } Process;
 
+typedef struct
+{
+    uint64_t key;
+    uint64_t counter;
+} Rng;
+
+typedef struct
+{
+    float min_working_day;
+    float max_working_day;
+    float min_days_per_week;
+    float max_days_per_week;
+    /* wages are double precision, as their defaults are */
+    double min_wage;
+    double max_wage;
+    unsigned int initial_workers;
+    unsigned int min_workers;
+    unsigned int max_workers;
+    float min_productivity;
+    float max_productivity;
+    float initial_deposit;
+    float initial_merchant_deposit;
+    float initial_bank_deposit;
+    float initial_state_deposit;
+    float initial_rentier_deposit;
+    float max_merchant_stock;
+    float min_bank_interest;
+    float max_bank_interest;
+    float max_loan_interest;
+    float min_savings_rate;
+    float max_savings_rate;
+    unsigned int history_steps;
+    unsigned int locations;
+    float min_vat_rate;
+    float max_vat_rate;
+    float min_business_tax_rate;
+    float max_business_tax_rate;
+    float min_loan;
+    double min_citizens_dividend;
+    double max_citizens_dividend;
+} Params;
+
+enum {
+    PARAM_FLOAT,
+    PARAM_DOUBLE,
+    PARAM_UNSIGNED
+};
+
+typedef struct
+{
+    const char * name;
+    size_t offset;
+    unsigned int type;
+} ParamInfo;
+
+typedef struct
+{
+    unsigned int count;
+    double mean;
+    double m2;
+} Moments;
+
+typedef struct
+{
+    double p;
+    unsigned int count;
+    double q[5];
+    double n[5];
+    double np[5];
+    double dn[5];
+} Quantile;
+
+/* purchases and strategy decisions of a firm which are settled
+   after firms have been updated concurrently */
+typedef struct
+{
+    float required[PROCESS_INPUTS];
+    unsigned int laid_off;
+    float loan;
+    int loan_bank;
+} FirmOrder;
+
 typedef struct
 {
     Capital capital;
@@ -160,16 +297,46 @@ typedef struct
     float sale_value;
 } Firm;
 
+/* refers to an account slot within a bank, or to none if bank is -1 */
+typedef struct
+{
+    int bank;
+    int slot;
+} AccountRef;
+
+typedef struct
+{
+    unsigned int now;
+    unsigned int capacity;
+    /* lists of items in each slot of each level, then of those due */
+    int head[WHEEL_LEVELS*WHEEL_SLOTS + 1];
+    int * next;
+    int * prev;
+    int * bucket;
+    unsigned int * when;
+} Wheel;
+
 typedef struct
 {
     unsigned int entity_type;
     unsigned int entity_index;
+    /* the next account held by the same entity */
+    AccountRef next;
     float balance;
     float loan;
     float loan_interest_rate;
     unsigned int loan_elapsed_days;
     float loan_repaid;
     float loan_repayment_per_month;
+    /* the amount due with interest so far, and the growth in it over
+       the number of days between updates */
+    double loan_due;
+    double loan_accrual;
+    unsigned int loan_accrual_days;
+    /* day on which the loan is next checked for being repaid */
+    unsigned int loan_check_day;
+    /* position within the bank's list of open accounts */
+    unsigned int live_position;
 } Account;
 
 typedef struct
@@ -179,9 +346,26 @@ typedef struct
     float interest_deposit;
     float interest_loan;
     unsigned int active_accounts;
-    Account account[MAX_ACCOUNTS];
+    /* totals over the open accounts */
+    double loans;
+    double balances;
+    /* account slots grow as needed. Closed ones form a free list,
+       linked through next.slot */
+    unsigned int max_accounts;
+    int free_account;
+    Account * account;
+    /* the open accounts, of which there are active_accounts */
+    unsigned int * live;
+    /* loans by the day on which they are next checked */
+    Wheel maturities;
 } Bank;
 
+typedef struct
+{
+    float interest_loan;
+    float worth;
+} BankAverages;
+
 typedef struct
 {
     Capital capital;
@@ -202,55 +386,355 @@ typedef struct
     float citizens_dividend;
 } State;
 
+typedef struct
+{
+    unsigned int product_type;
+    unsigned int location;
+    float value;
+    float stock;
+} MarketEntry;
+
+typedef struct
+{
+    unsigned int length;
+    unsigned int capacity;
+    unsigned int * item;
+    float * key;
+} Heap;
+
+typedef struct
+{
+    /* totals of sale value and of whole units of stock. Average prices
+       have always counted each firm's stock in whole units */
+    double value[MAX_PRODUCT_TYPES][MAX_LOCATIONS];
+    double stock[MAX_PRODUCT_TYPES][MAX_LOCATIONS];
+    unsigned int size;
+    MarketEntry * entry;
+
+    /* firms with stock to sell, ordered by sale value */
+    Heap book[MAX_PRODUCT_TYPES][MAX_LOCATIONS];
+    int * book_position;
+} Market;
+
+typedef struct
+{
+    unsigned int size;
+    int * left;
+    int * right;
+    unsigned int * priority;
+    float * key;
+    unsigned int * weight;
+    unsigned int * min_weight;
+} Treap;
+
+typedef struct
+{
+    unsigned int size;
+    unsigned int leaves;
+    float * key;
+    int * winner;
+} Tournament;
+
+typedef struct
+{
+    unsigned int size;
+    float * workers;
+    float * days_per_week;
+    float * wage_rate;
+    float * productivity;
+    float * time_total;
+    float * constant;
+    float * repayment_per_month;
+    float * sale_value;
+    float * stock;
+    float * surplus;
+    float * raw_material_stock[PROCESS_INPUTS];
+
+    /* taken from the economy parameters */
+    float initial_workers;
+
+    /* outputs of firm_store_daily */
+    float * products_per_day;
+    float * wages_per_day;
+    float * fixed_per_day;
+    float * surplus_per_day;
+} FirmStore;
+
+/* operations counted when profiling */
+enum {
+    COUNT_BEST_PRICE,
+    COUNT_SCANS,
+    COUNT_FIRMS_VISITED,
+    COUNT_ACCOUNT_PROBES,
+    COUNT_LOANS_ISSUED,
+    COUNT_LOANS_CLOSED,
+    COUNT_MERGERS,
+    COUNT_HIRES,
+    COUNTERS
+};
+
+/* hardware events which may be counted for each phase */
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_EVENTS
+};
+
+#ifdef ECON_PROFILE
+/* time spent within each phase in nanoseconds, operation counts and,
+   if enabled, hardware event counts for each phase */
+typedef struct
+{
+    unsigned int ticks;
+    uint64_t last[PHASES];
+    uint64_t total[PHASES];
+    uint64_t count[COUNTERS];
+    uint64_t count_last[COUNTERS];
+    uint64_t count_total[COUNTERS];
+    int perf;
+    int perf_fd[PERF_EVENTS];
+    uint64_t perf_total[PHASES][PERF_EVENTS];
+} Profile;
+
+#define PROFILE_COUNT(e, counter, n) ((e)->profile.count[counter] += (n))
+#else
+#define PROFILE_COUNT(e, counter, n) ((void)0)
+#endif
+
+/* counts a scan over every firm */
+#define PROFILE_SCAN(e) \
+    (PROFILE_COUNT(e, COUNT_SCANS, 1), PROFILE_COUNT(e, COUNT_FIRMS_VISITED, (e)->size))
+
+typedef struct
+{
+    unsigned int size;
+    unsigned int banks;
+    unsigned int accounts;
+    unsigned int rentiers;
+    unsigned int tick_mode;
+    int simd;
+    unsigned int threads;
+    uint64_t seed;
+    Params params;
+} EconomyConfig;
+
 typedef struct
 {
     unsigned int size;
-    Firm firm[MAX_ECONOMY_SIZE];
+    Firm * firm;
+    Params params;
     Merchant merchant;
-    Bank bank[MAX_BANKS];
-    State state[LOCATIONS];
-    Rentier rentier[MAX_RENTIERS];
+    unsigned int banks;
+    Bank * bank;
+    BankAverages bank_averages;
+    State state[MAX_LOCATIONS];
+    unsigned int rentiers;
+    Rentier * rentier;
     unsigned int bankruptcies;
+    uint64_t seed;
+    unsigned int tick;
+    unsigned int tick_mode;
+    int simd;
+    unsigned int threads;
+    FirmOrder * orders;
+    unsigned int * restarts;
+    Market market;
+    Treap mergers;
+    Tournament wages;
+    Heap recruits[MAX_LOCATIONS];
+    int * recruit_position;
+    FirmStore store;
+
+    /* first account held by each entity, by entity type and index */
+    AccountRef * account_list[ENTITIES];
+
+    /* checkpoint mapping which holds the firms and rentiers, if loaded */
+    void * mapping;
+    size_t mapping_size;
+
+    /* if hash_bits is non-zero the state is hashed after each phase */
+    unsigned int hash_bits;
+    uint64_t hash;
+    uint64_t phase_hash[PHASES];
+
+#ifdef ECON_PROFILE
+    Profile profile;
+#endif
 } Economy;
 
+typedef struct series Series;
+
 float working_capital(Capital * c);
 void subtract_capital(Capital * c, float amount);
 
+typedef void (*ParallelFunction)(void * arg, unsigned int start, unsigned int end);
+
+void parallel_for(unsigned int threads, unsigned int n, ParallelFunction fn, void * arg);
+
+void rng_init(Rng * r, uint64_t seed,
+              unsigned int entity_type, unsigned int entity_index,
+              unsigned int tick);
+unsigned int rng_next(Rng * r);
+unsigned int rng_range(Rng * r, unsigned int n);
+float rng_uniform(Rng * r);
+
+void moments_init(Moments * m);
+void moments_add(Moments * m, double x);
+double moments_stddev(Moments * m);
+void quantile_init(Quantile * q, double p);
+void quantile_add(Quantile * q, double x);
+double quantile_value(Quantile * q);
+
+void params_init(Params * p);
+int params_valid(Params * p);
+const ParamInfo * params_find(const char * name);
+unsigned int params_count(void);
+const ParamInfo * params_info(unsigned int index);
+double params_get(Params * p, const ParamInfo * info);
+void params_set(Params * p, const ParamInfo * info, double value);
+
 void clear_history(Capital * c);
-void update_history(Capital * c);
+void update_history(Capital * c, unsigned int steps);
+
+void econ_config_init(EconomyConfig * config);
+Economy * econ_alloc(EconomyConfig * config, int entities);
+Economy * econ_create(EconomyConfig * config);
+void econ_destroy(Economy * e);
+void econ_update(Economy * e, unsigned int weeks);
+void econ_step(Economy * e, unsigned int phase, unsigned int weeks);
+const char * econ_phase_name(unsigned int phase);
+int econ_set_params(Economy * e, Params * params);
+void econ_summary(Economy * e, double * summary);
+void econ_summary_header(FILE * fp);
+
+int ensemble_run(EconomyConfig * config, unsigned int runs, unsigned int threads,
+                 unsigned int ticks, FILE * fp);
+Series * series_open(Economy * e, const char * filename, const char * metrics);
+void series_record(Series * s, Economy * e);
+int series_close(Series * s);
+
+#ifdef ECON_PROFILE
+uint64_t profile_clock(void);
+void profile_begin(Profile * p, uint64_t * sample);
+void profile_end(Profile * p, unsigned int phase, uint64_t * sample);
+void profile_tick(Profile * p);
+int profile_perf_open(Profile * p);
+void profile_perf_close(Profile * p);
+void profile_report(Profile * p, FILE * fp);
+#endif
+
+uint64_t econ_hash(Economy * e, unsigned int bits);
+void econ_hash_phase(Economy * e, unsigned int phase);
+unsigned int econ_hash_diff(Economy * a, Economy * b, unsigned int bits, FILE * fp);
+int bisect_run(EconomyConfig * config_a, EconomyConfig * config_b,
+               unsigned int ticks, unsigned int bits, FILE * fp);
+
+int golden_compare(const char * reference, const char * candidate,
+                   double rtol, double atol, FILE * report);
+int golden_compare_means(const char * reference, const char * candidate,
+                         const char * tolerances, unsigned int warmup, FILE * report);
+
+int econ_save(Economy * e, const char * filename);
+Economy * econ_load(const char * filename);
+
+int scenario_run(Economy * e, const char * filename, unsigned int branches,
+                 unsigned int ticks, FILE * fp);
+int sweep_run(EconomyConfig * config, const char * filename, unsigned int threads,
+              unsigned int ticks, FILE * fp);
 
 float econ_average_price(Economy * e, unsigned int product_type, unsigned int location);
 float econ_average_price_global(Economy * e, unsigned int product_type);
 int econ_best_price(Economy * e, Firm * f, unsigned int product_type, unsigned int local);
 float econ_average_price_variance(Economy * e, unsigned int product_type);
 
-void firm_init(Firm * f);
+void heap_init(Heap * h);
+void heap_free(Heap * h);
+void heap_clear(Heap * h, int * position);
+int heap_reserve(Heap * h, unsigned int capacity);
+int heap_insert(Heap * h, int * position, unsigned int item, float key);
+void heap_remove(Heap * h, int * position, unsigned int item);
+void heap_update(Heap * h, int * position, unsigned int item, float key);
+int heap_top(Heap * h);
+int heap_top_excluding(Heap * h, unsigned int item);
+
+int treap_init(Treap * t, unsigned int size);
+void treap_free(Treap * t);
+int treap_insert(Treap * t, int root, unsigned int item, float key, unsigned int weight);
+int treap_remove(Treap * t, int root, unsigned int item);
+int treap_find(Treap * t, int * root, float below, unsigned int max_weight);
+
+int tournament_init(Tournament * t, unsigned int size);
+void tournament_free(Tournament * t);
+void tournament_build(Tournament * t);
+void tournament_set(Tournament * t, unsigned int item, float key);
+int tournament_best(Tournament * t, unsigned int start, unsigned int end);
+
+int wheel_init(Wheel * w, unsigned int capacity);
+void wheel_free(Wheel * w);
+int wheel_resize(Wheel * w, unsigned int capacity);
+void wheel_clear(Wheel * w, unsigned int now);
+void wheel_insert(Wheel * w, unsigned int item, unsigned int when);
+void wheel_remove(Wheel * w, unsigned int item);
+void wheel_advance(Wheel * w, unsigned int now);
+int wheel_pop(Wheel * w);
+
+int market_init(Market * m, unsigned int size, unsigned int locations);
+void market_free(Market * m);
+void market_update(Economy * e, unsigned int index);
+void market_rebuild(Economy * e);
+
+int firm_store_init(FirmStore * s, unsigned int size, Params * p);
+void firm_store_free(FirmStore * s);
+void firm_store_load(FirmStore * s, Economy * e, unsigned int start, unsigned int end);
+void firm_store_save(FirmStore * s, Economy * e, unsigned int start, unsigned int end);
+void firm_store_daily(FirmStore * s, unsigned int start, unsigned int end);
+void firm_store_production(FirmStore * s, unsigned int weeks,
+                           unsigned int start, unsigned int end, int simd);
+
+void firm_init(Firm * f, Params * p, Rng * rng);
 int firm_defunct(Firm * f);
+int firm_index(Firm * f, Economy * e);
 float firm_worth(Firm * f);
+void firm_orders(Firm * f, Params * p, unsigned int weeks, FirmOrder * order);
+void firm_settle_orders(Firm * f, Economy * e, unsigned int weeks, FirmOrder * order);
+void firm_purchasing(Firm * f, Economy * e, unsigned int weeks);
+void firm_production(Firm * f, Params * p, unsigned int weeks);
+int firm_loan_application(Firm * f, Economy * e, float * amount);
+void firm_obtain_loan(Firm * f, Economy * e, int bank_index, float amount);
+void firm_strategy(Firm * f, Economy * e, float surplus_per_day, FirmOrder * order);
 void firm_update(Firm * f, Economy * e, unsigned int weeks);
 
-void merchant_init(Merchant * m);
+void merchant_init(Merchant * m, Params * p, Rng * rng);
 void merchant_update(Economy * e);
 
-void bank_init(Bank * b);
+int bank_alloc(Bank * b, unsigned int accounts);
+void bank_free(Bank * b);
+int bank_restore(Bank * b, Bank * saved, Account * accounts);
+void bank_init(Bank * b, Params * p, Rng * rng);
+int bank_index_init(Economy * e);
+void bank_index_free(Economy * e);
+void bank_index_rebuild(Economy * e);
+void bank_index_remove(Bank * b, Economy * e);
+AccountRef * bank_account_list(Economy * e, unsigned int entity_type, unsigned int entity_index);
+void bank_account_close(Bank * b, Economy * e, unsigned int account_index);
 int bank_defunct(Bank * b);
 int bank_account_defunct(Account * a);
-int bank_account_index(Bank * b, unsigned int entity_type, unsigned int entity_index);
+int bank_account_index(Bank * b, Economy * e, unsigned int entity_type, unsigned int entity_index);
 void bank_update(Bank * b, Economy * e, unsigned int increment_days);
 void bank_issue_loan(Bank * b, Economy * e,
                      unsigned int entity_type, unsigned int entity_index,
                      float amount, unsigned int repayment_days);
 void bank_account_close_entity(Bank * b, Economy * e, unsigned int entity_type, unsigned int entity_index);
-float bank_average_interest_loan(Economy * e);
-float bank_average_interest_deposit(Economy * e);
+void bank_averages_update(Economy * e);
 float bank_worth(Bank * b);
 Bank * best_bank_for_savings(Economy * e);
 Bank * best_bank_for_loan(Economy * e);
 
-void state_init(State * s);
+void state_init(State * s, Params * p, Rng * rng);
 void state_update(State * s, Economy * e, unsigned int weeks);
 
-void rentier_init(Rentier * r);
+void rentier_init(Rentier * r, Params * p, Rng * rng);
 void rentier_update(Rentier * r, Economy * e, unsigned int weeks);
 
 #endif
@@ -0,0 +1,250 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Monte Carlo ensembles. Many independent economies, each with its own
+   seed and its own allocation, are run across a pool of threads. Per-tick
+   aggregates from each run are merged into streaming means and quantiles
+   in order of run number, so that only the trajectories of the runs in
+   progress are held in memory and the results do not depend upon the
+   number of threads */
+
+#include <pthread.h>
+#include "econ.h"
+
+#define ENSEMBLE_QUANTILES 3
+
+static const double ensemble_quantile[ENSEMBLE_QUANTILES] = { 0.05, 0.5, 0.95 };
+
+typedef struct
+{
+    EconomyConfig * config;
+    unsigned int runs;
+    unsigned int ticks;
+    unsigned int metrics;
+    unsigned int next_run;
+    unsigned int next_merge;
+    unsigned int failures;
+    Moments * moments;
+    Quantile * quantiles;
+    pthread_mutex_t lock;
+    pthread_cond_t merged;
+} Ensemble;
+
+static unsigned int ensemble_metrics(EconomyConfig * config)
+{
+    return 1 + config->params.locations + MAX_PRODUCT_TYPES + config->banks;
+}
+
+static void ensemble_metric_name(EconomyConfig * config, unsigned int metric,
+                                 char * name, size_t length)
+{
+    unsigned int locations = config->params.locations;
+
+    if (metric == 0) {
+        snprintf(name, length, "bankruptcies");
+        return;
+    }
+    metric--;
+    if (metric < locations) {
+        snprintf(name, length, "unemployed_%u", metric);
+        return;
+    }
+    metric -= locations;
+    if (metric < MAX_PRODUCT_TYPES) {
+        snprintf(name, length, "merchant_stock_%u", metric);
+        return;
+    }
+    metric -= MAX_PRODUCT_TYPES;
+    snprintf(name, length, "bank_worth_%u", metric);
+}
+
+/* records the aggregates of interest for the current tick */
+static void ensemble_observe(Economy * e, float * row)
+{
+    unsigned int i, m = 0;
+
+    row[m++] = (float)e->bankruptcies;
+    for (i = 0; i < e->params.locations; i++) {
+        row[m++] = (float)e->state[i].unemployed;
+    }
+    for (i = 0; i < MAX_PRODUCT_TYPES; i++) {
+        row[m++] = e->merchant.stock[i];
+    }
+    for (i = 0; i < e->banks; i++) {
+        row[m++] = bank_worth(&e->bank[i]);
+    }
+}
+
+static void ensemble_merge(Ensemble * en, float * trajectory)
+{
+    unsigned int i, j, n = en->ticks * en->metrics;
+
+    for (i = 0; i < n; i++) {
+        moments_add(&en->moments[i], trajectory[i]);
+        for (j = 0; j < ENSEMBLE_QUANTILES; j++) {
+            quantile_add(&en->quantiles[i*ENSEMBLE_QUANTILES + j], trajectory[i]);
+        }
+    }
+}
+
+static void * ensemble_worker(void * arg)
+{
+    Ensemble * en = (Ensemble*)arg;
+    EconomyConfig config = *en->config;
+    unsigned int run, t;
+    float * trajectory;
+    Economy * e;
+
+    trajectory = (float*)malloc(en->ticks*en->metrics*sizeof(float));
+
+    while (1) {
+        pthread_mutex_lock(&en->lock);
+        run = en->next_run++;
+        pthread_mutex_unlock(&en->lock);
+        if (run >= en->runs) break;
+
+        config.seed = en->config->seed + run;
+        config.threads = 1;
+        e = NULL;
+        if (trajectory != NULL) e = econ_create(&config);
+        if (e != NULL) {
+            for (t = 0; t < en->ticks; t++) {
+                econ_update(e, 1);
+                ensemble_observe(e, &trajectory[t*en->metrics]);
+            }
+            econ_destroy(e);
+        }
+
+        /* wait for earlier runs to be merged */
+        pthread_mutex_lock(&en->lock);
+        while (en->next_merge != run) {
+            pthread_cond_wait(&en->merged, &en->lock);
+        }
+        if (e != NULL) {
+            ensemble_merge(en, trajectory);
+        }
+        else {
+            en->failures++;
+        }
+        en->next_merge++;
+        pthread_cond_broadcast(&en->merged);
+        pthread_mutex_unlock(&en->lock);
+    }
+
+    free(trajectory);
+    return NULL;
+}
+
+static void ensemble_report(Ensemble * en, FILE * fp)
+{
+    unsigned int t, m, i, j;
+    char name[64];
+
+    fprintf(fp, "tick,metric,runs,mean,stddev");
+    for (j = 0; j < ENSEMBLE_QUANTILES; j++) {
+        fprintf(fp, ",p%02d", (int)(ensemble_quantile[j]*100 + 0.5));
+    }
+    fprintf(fp, "\n");
+
+    for (t = 0; t < en->ticks; t++) {
+        for (m = 0; m < en->metrics; m++) {
+            i = t*en->metrics + m;
+            ensemble_metric_name(en->config, m, name, sizeof(name));
+            fprintf(fp, "%u,%s,%u,%.9g,%.9g", t, name, en->moments[i].count,
+                    en->moments[i].mean, moments_stddev(&en->moments[i]));
+            for (j = 0; j < ENSEMBLE_QUANTILES; j++) {
+                fprintf(fp, ",%.9g", quantile_value(&en->quantiles[i*ENSEMBLE_QUANTILES + j]));
+            }
+            fprintf(fp, "\n");
+        }
+    }
+}
+
+/* Runs a number of economies, each seeded from the configured seed plus
+   its run number, using the given number of threads. The per-tick mean,
+   standard deviation and quantiles of each aggregate are written as CSV.
+   Returns the number of runs which could not be carried out, or -1 on error */
+int ensemble_run(EconomyConfig * config, unsigned int runs, unsigned int threads,
+                 unsigned int ticks, FILE * fp)
+{
+    Ensemble en;
+    pthread_t * thread;
+    unsigned int i, j, n, started = 0;
+
+    en.config = config;
+    en.runs = runs;
+    en.ticks = ticks;
+    en.metrics = ensemble_metrics(config);
+    en.next_run = 0;
+    en.next_merge = 0;
+    en.failures = 0;
+
+    n = ticks * en.metrics;
+    en.moments = (Moments*)malloc(n*sizeof(Moments));
+    en.quantiles = (Quantile*)malloc(n*ENSEMBLE_QUANTILES*sizeof(Quantile));
+    if (threads == 0) threads = 1;
+    if (threads > runs) threads = runs;
+    thread = (pthread_t*)malloc(threads*sizeof(pthread_t));
+    if ((en.moments == NULL) || (en.quantiles == NULL) || (thread == NULL)) {
+        free(en.moments);
+        free(en.quantiles);
+        free(thread);
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        moments_init(&en.moments[i]);
+        for (j = 0; j < ENSEMBLE_QUANTILES; j++) {
+            quantile_init(&en.quantiles[i*ENSEMBLE_QUANTILES + j], ensemble_quantile[j]);
+        }
+    }
+    pthread_mutex_init(&en.lock, NULL);
+    pthread_cond_init(&en.merged, NULL);
+
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&thread[i], NULL, ensemble_worker, &en) != 0) break;
+        started++;
+    }
+    if (started == 0) {
+        ensemble_worker(&en);
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(thread[i], NULL);
+    }
+
+    ensemble_report(&en, fp);
+
+    pthread_mutex_destroy(&en.lock);
+    pthread_cond_destroy(&en.merged);
+    free(en.moments);
+    free(en.quantiles);
+    free(thread);
+    return (int)en.failures;
+}
@@ -31,12 +31,12 @@
 
 #include "econ.h"
 
-void firm_init_process(Firm * f)
+void firm_init_process(Firm * f, Rng * rng)
 {
     unsigned int i;
 
     /* the kind of product made is non-primitive */
-    f->process.product_type = 1 + (unsigned int)(rand()%(MAX_PRODUCT_TYPES-1));
+    f->process.product_type = 1 + rng_range(rng, MAX_PRODUCT_TYPES-1);
     f->process.stock = 0;
 
     /* note that material inputs can be primitive */
@@ -44,35 +44,35 @@ void firm_init_process(Firm * f)
         f->process.raw_material_stock[i] = 0;
         f->process.raw_material[i] = f->process.product_type;
         while (f->process.raw_material[i] == f->process.product_type) {
-            f->process.raw_material[i] = (unsigned int)(rand()%MAX_PRODUCT_TYPES);
+            f->process.raw_material[i] = rng_range(rng, MAX_PRODUCT_TYPES);
         }
     }
 }
 
-void firm_init(Firm * f)
+void firm_init(Firm * f, Params * p, Rng * rng)
 {
-    firm_init_process(f);
-    f->location = (unsigned int)(rand()%LOCATIONS);
-    f->labour.wage_rate = MIN_WAGE +
-        ((rand()%10000/10000.0f)*(MAX_WAGE - MIN_WAGE));
-    f->labour.productivity = MIN_PRODUCTIVITY +
-        ((rand()%10000/10000.0f)*(MAX_PRODUCTIVITY - MIN_PRODUCTIVITY));
-    f->labour.workers = INITIAL_WORKERS;
+    firm_init_process(f, rng);
+    f->location = rng_range(rng, p->locations);
+    f->labour.wage_rate = p->min_wage +
+        (rng_uniform(rng)*(p->max_wage - p->min_wage));
+    f->labour.productivity = p->min_productivity +
+        (rng_uniform(rng)*(p->max_productivity - p->min_productivity));
+    f->labour.workers = p->initial_workers;
     f->labour.is_recruiting = 0;
     f->labour.days_per_week =
-        (unsigned int)(MIN_DAYS_PER_WEEK +
-                       ((rand()%10000/10000.0f)*
-                        (MAX_DAYS_PER_WEEK - MIN_DAYS_PER_WEEK)));
+        (unsigned int)(p->min_days_per_week +
+                       (rng_uniform(rng)*
+                        (p->max_days_per_week - p->min_days_per_week)));
     f->labour.time_total =
-        MIN_WORKING_DAY +
-        ((rand()%10000/10000.0f)*(MAX_WORKING_DAY - MIN_WORKING_DAY));
+        p->min_working_day +
+        (rng_uniform(rng)*(p->max_working_day - p->min_working_day));
     f->labour.time_necessary = f->labour.time_total/2;
-    f->capital.savings_rate = MIN_SAVINGS_RATE +
-        ((rand()%10000/10000.0f)*(MAX_SAVINGS_RATE - MIN_SAVINGS_RATE));
+    f->capital.savings_rate = p->min_savings_rate +
+        (rng_uniform(rng)*(p->max_savings_rate - p->min_savings_rate));
     f->capital.repayment_per_month = 0;
     f->capital.variable = 0;
     f->capital.constant = 10;
-    f->capital.fictitious = INITIAL_DEPOSIT;
+    f->capital.fictitious = p->initial_deposit;
     f->capital.surplus = 0;
     f->sale_value = 1.50f;
     clear_history(&f->capital);
@@ -84,9 +84,9 @@ int firm_defunct(Firm * f)
 }
 
 /* See http://www.cybaea.net/Blogs/employee_productivity.html */
-float firm_productivity_per_worker(Firm * f)
+float firm_productivity_per_worker(Firm * f, Params * p)
 {
-    return f->labour.productivity * INITIAL_WORKERS / (1 + (float)(f->labour.workers));
+    return f->labour.productivity * p->initial_workers / (1 + (float)(f->labour.workers));
 }
 
 /* fixed outgoings per day. This is assumed to depend on the number of workers */
@@ -102,14 +102,14 @@ float firm_variable_labour_per_day(Firm * f)
 }
 
 /* how many products are made per day? */
-float firm_products_made_per_day(Firm * f)
+float firm_products_made_per_day(Firm * f, Params * p)
 {
-    return firm_productivity_per_worker(f) * f->labour.time_total * f->labour.workers;
+    return firm_productivity_per_worker(f, p) * f->labour.time_total * f->labour.workers;
 }
 
-float firm_sales_income_per_day(Firm * f, float product_sale_value)
+float firm_sales_income_per_day(Firm * f, Params * p, float product_sale_value)
 {
-    return product_sale_value * firm_products_made_per_day(f);
+    return product_sale_value * firm_products_made_per_day(f, p);
 }
 
 float firm_products_which_can_be_made(Firm * f)
@@ -127,9 +127,9 @@ float firm_products_which_can_be_made(Firm * f)
 }
 
 /* how many products can be made and sold in one day, given raw materials */
-float firm_sales_income_per_day_actual(Firm * f, float product_sale_value)
+float firm_sales_income_per_day_actual(Firm * f, Params * p, float product_sale_value)
 {
-    float max_products_made = firm_products_made_per_day(f);
+    float max_products_made = firm_products_made_per_day(f, p);
     float potential_products = firm_products_which_can_be_made(f);
     if (potential_products > max_products_made)
         return product_sale_value * max_products_made;
@@ -137,11 +137,11 @@ float firm_sales_income_per_day_actual(Firm * f, float product_sale_value)
 }
 
 /* given a certain expected profit how much can individual products be sold for? */
-float firm_product_sale_value(Firm * f, float surplus_per_day)
+float firm_product_sale_value(Firm * f, Params * p, float surplus_per_day)
 {
     return (surplus_per_day + firm_variable_labour_per_day(f) +
             firm_constant_per_day(f)) /
-        firm_products_made_per_day(f);
+        firm_products_made_per_day(f, p);
 }
 
 float firm_loan_repayment_per_day(Firm *f)
@@ -150,81 +150,93 @@ float firm_loan_repayment_per_day(Firm *f)
 }
 
 /* labour time needed for zero profit */
-float firm_necessary_labour_time(Firm * f)
+float firm_necessary_labour_time(Firm * f, Params * p)
 {
     return firm_variable_labour_per_day(f) * f->labour.time_total /
-        (firm_sales_income_per_day(f,f->sale_value) - firm_constant_per_day(f) - firm_loan_repayment_per_day(f));
+        (firm_sales_income_per_day(f, p, f->sale_value) - firm_constant_per_day(f) - firm_loan_repayment_per_day(f));
 }
 
-float firm_necessary_variable_labour_per_day(Firm * f)
+float firm_necessary_variable_labour_per_day(Firm * f, Params * p)
 {
-    return f->labour.wage_rate * firm_necessary_labour_time(f) * f->labour.workers;
+    return f->labour.wage_rate * firm_necessary_labour_time(f, p) * f->labour.workers;
 }
 
-float firm_surplus_per_day(Firm * f)
+float firm_surplus_per_day(Firm * f, Params * p)
 {
-    return firm_sales_income_per_day(f,f->sale_value) -
+    return firm_sales_income_per_day(f, p, f->sale_value) -
         (firm_variable_labour_per_day(f) + firm_constant_per_day(f) + firm_loan_repayment_per_day(f));
 }
 
-float firm_surplus_per_day_actual(Firm * f)
+float firm_surplus_per_day_actual(Firm * f, Params * p)
 {
-    return firm_sales_income_per_day_actual(f,f->sale_value) -
+    return firm_sales_income_per_day_actual(f, p, f->sale_value) -
         (firm_variable_labour_per_day(f) + firm_constant_per_day(f) + firm_loan_repayment_per_day(f));
 }
 
 int firm_index(Firm * f, Economy * e)
 {
-    unsigned int i;
-    Firm * f2;
-
-    for (i = 0; i < e->size; i++) {
-        f2 = &e->firm[i];
-        if (f2 == f) return (int)i;
-    }
-    return -1;
+    if ((f < e->firm) || (f >= e->firm + e->size)) return -1;
+    return (int)(f - e->firm);
 }
 
-void firm_obtain_loan(Firm * f, Economy * e)
+/* Decides how much to borrow and from which bank. Returns the index
+   of the lending bank, or -1 if no loan can be obtained */
+int firm_loan_application(Firm * f, Economy * e, float * amount)
 {
     Bank * best;
-    float amount;
-    unsigned int repayment_days;
-    int index;
-
-    if (f->capital.repayment_per_month == 0) {
-        best = best_bank_for_loan(e);
-        if (best != NULL) {
-            repayment_days = 30*6;
-            amount = firm_surplus_per_day(f) * repayment_days;
-            if (amount < MIN_LOAN) amount = MIN_LOAN;
-            index = firm_index(f, e);
-            if (index > -1) {
-                bank_issue_loan(best, e, ENTITY_FIRM,
-                                (unsigned int)index,
-                                amount, repayment_days);
-            }
-        }
-    }
+    Params * p = &e->params;
+
+    if (f->capital.repayment_per_month != 0) return -1;
+
+    best = best_bank_for_loan(e);
+    if (best == NULL) return -1;
+
+    *amount = firm_surplus_per_day(f, p) * LOAN_REPAYMENT_DAYS;
+    if (*amount < p->min_loan) *amount = p->min_loan;
+    return (int)(best - e->bank);
+}
+
+void firm_obtain_loan(Firm * f, Economy * e, int bank_index, float amount)
+{
+    int index = firm_index(f, e);
+
+    if ((bank_index < 0) || (index < 0)) return;
+    bank_issue_loan(&e->bank[bank_index], e, ENTITY_FIRM,
+                    (unsigned int)index, amount, LOAN_REPAYMENT_DAYS);
 }
 
-void firm_strategy(Firm * f, Economy * e)
+/* Adjusts the workforce and sale value, given the firm's current surplus
+   per day, which callers updating many firms take from the firm store.
+   If an order is given then any loan application and layoffs are
+   recorded within it, rather than being applied to the banks and
+   states, so that firms may review their strategies concurrently */
+void firm_strategy(Firm * f, Economy * e, float surplus_per_day, FirmOrder * order)
 {
+    Params * p = &e->params;
     float possible_capital, average_price, original_sale_value;
-    float existing_capital = firm_surplus_per_day(f) + f->capital.fictitious;
+    float existing_capital = surplus_per_day + f->capital.fictitious;
+    float amount = 0;
     unsigned int workers;
+    int bank_index;
 
     if (firm_defunct(f)) return;
 
     if (existing_capital < 0) {
-        firm_obtain_loan(f, e);
+        bank_index = firm_loan_application(f, e, &amount);
+        if (order != NULL) {
+            order->loan_bank = bank_index;
+            order->loan = amount;
+        }
+        else {
+            firm_obtain_loan(f, e, bank_index, amount);
+        }
     }
 
     /* will recruiting more workers increase surplus ? */
-    if (f->labour.workers < MAX_WORKERS) {
+    if (f->labour.workers < p->max_workers) {
         f->labour.is_recruiting = 0;
         f->labour.workers++;
-        possible_capital = firm_surplus_per_day(f) + f->capital.fictitious;
+        possible_capital = firm_surplus_per_day(f, p) + f->capital.fictitious;
         f->labour.workers--;
         if (possible_capital > existing_capital) {
             f->labour.is_recruiting = 1;
@@ -234,11 +246,16 @@ void firm_strategy(Firm * f, Economy * e)
     /* will laying off workers increase surplus ? */
     if ((f->labour.workers > 2) && (f->labour.is_recruiting == 0)) {
         workers = f->labour.workers;
-        while ((firm_surplus_per_day(f) < 0) && (f->labour.workers > MIN_WORKERS)) {
+        while ((firm_surplus_per_day(f, p) < 0) && (f->labour.workers > p->min_workers)) {
             f->labour.workers--;
         }
         if (f->labour.workers != workers) {
-            e->state[f->location].unemployed += workers - f->labour.workers;
+            if (order != NULL) {
+                order->laid_off = workers - f->labour.workers;
+            }
+            else {
+                e->state[f->location].unemployed += workers - f->labour.workers;
+            }
         }
     }
 
@@ -253,7 +270,7 @@ void firm_strategy(Firm * f, Economy * e)
     if (average_price*1.05f < f->sale_value) {
         original_sale_value = f->sale_value;
         f->sale_value *= 0.99f;
-        if (firm_surplus_per_day(f) + f->capital.fictitious <= 0) {
+        if (firm_surplus_per_day(f, p) + f->capital.fictitious <= 0) {
             f->sale_value = original_sale_value;
         }
     }
@@ -318,52 +335,78 @@ void firm_buy_raw_material_locally(Firm * f, Economy * e, unsigned int index, fl
         f->process.raw_material_stock[index] += buy_quantity;
         supplier->process.stock -= buy_quantity;
         if (supplier->process.stock < 0) supplier->process.stock = 0;
+        market_update(e, (unsigned int)best_index);
         quantity -= buy_quantity;
 
         best_index = econ_best_price(e, f, product_type, 1);
     }
 }
 
-void firm_purchasing(Firm * f, Economy * e, unsigned int weeks)
+/* works out how much of each raw material needs to be bought over the
+   given number of weeks. Primitive materials are freely available and
+   so are obtained immediately */
+void firm_orders(Firm * f, Params * p, unsigned int weeks, FirmOrder * order)
 {
     unsigned int i;
     float purchases_required;
 
     for (i = 0; i < PROCESS_INPUTS; i++) {
         purchases_required =
-            (firm_products_made_per_day(f) * f->labour.days_per_week * weeks) -
+            (firm_products_made_per_day(f, p) * f->labour.days_per_week * weeks) -
             f->process.raw_material_stock[i];
 
         if (f->process.raw_material[i] == PRODUCT_PRIMITIVE) {
             f->process.raw_material_stock[i] += purchases_required;
+            order->required[i] = 0;
             continue;
         }
+        order->required[i] = purchases_required;
+    }
+}
 
-        firm_buy_raw_material_from_merchant(f, e, i, purchases_required);
+/* buys the ordered raw materials, first from the merchant and then
+   from local suppliers */
+void firm_settle_orders(Firm * f, Economy * e, unsigned int weeks, FirmOrder * order)
+{
+    unsigned int i;
+    float purchases_required;
+    Params * p = &e->params;
+
+    for (i = 0; i < PROCESS_INPUTS; i++) {
+        if (f->process.raw_material[i] == PRODUCT_PRIMITIVE) continue;
+
+        firm_buy_raw_material_from_merchant(f, e, i, order->required[i]);
 
         purchases_required =
-            (firm_products_made_per_day(f) * f->labour.days_per_week * weeks) -
+            (firm_products_made_per_day(f, p) * f->labour.days_per_week * weeks) -
             f->process.raw_material_stock[i];
         firm_buy_raw_material_locally(f, e, i, purchases_required);
     }
 }
 
-void firm_update(Firm * f, Economy * e, unsigned int weeks)
+void firm_purchasing(Firm * f, Economy * e, unsigned int weeks)
+{
+    FirmOrder order;
+
+    firm_orders(f, &e->params, weeks, &order);
+    firm_settle_orders(f, e, weeks, &order);
+}
+
+/* makes products from the raw materials in stock over the given number of weeks */
+void firm_production(Firm * f, Params * p, unsigned int weeks)
 {
     unsigned int i, days;
     float new_products, products_per_day;
 
-    firm_purchasing(f, e, weeks);
-
     /* how many days can we go without running out of raw materials ? */
     days = f->labour.days_per_week * weeks;
     new_products = firm_products_which_can_be_made(f);
-    products_per_day = firm_products_made_per_day(f);
+    products_per_day = firm_products_made_per_day(f, p);
     if (products_per_day*days < new_products/products_per_day) {
         days = (unsigned int)(new_products / products_per_day);
     }
 
-    f->capital.surplus += firm_surplus_per_day_actual(f) * days;
+    f->capital.surplus += firm_surplus_per_day_actual(f, p) * days;
     f->process.stock += (products_per_day * days);
     for (i = 0; i < PROCESS_INPUTS; i++) {
         f->process.raw_material_stock[i] -= (products_per_day * days);
@@ -371,7 +414,17 @@ void firm_update(Firm * f, Economy * e, unsigned int weeks)
             f->process.raw_material_stock[i] = 0;
         }
     }
+}
+
+void firm_update(Firm * f, Economy * e, unsigned int weeks)
+{
+    unsigned int index = (unsigned int)firm_index(f, e);
+
+    firm_purchasing(f, e, weeks);
+    firm_production(f, &e->params, weeks);
+    market_update(e, index);
 
-    firm_strategy(f, e);
-    update_history(&f->capital);
+    firm_strategy(f, e, firm_surplus_per_day(f, &e->params), NULL);
+    market_update(e, index);
+    update_history(&f->capital, e->params.history_steps);
 }
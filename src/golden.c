@@ -0,0 +1,354 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Comparison of time series against a golden trajectory. The reference
+   implementation, which runs single threaded without SIMD, records a
+   time series for a fixed seed. The same run is then made with the
+   optimised paths enabled, and each value is compared against the
+   reference within an absolute plus relative tolerance. The first tick
+   and column at which the trajectories diverge are reported.
+
+   Runs whose firms act in a different order cannot be expected to
+   follow the same trajectory, so they are compared statistically
+   instead. Each named metric is totalled over its columns, and the
+   mean of that total after a warm-up is compared within a tolerance
+   given for the metric. A metric whose total never changes in the
+   reference is reported as a failure, since agreement on a constant
+   says nothing about the run */
+
+#include "econ.h"
+
+#define GOLDEN_LINE_LENGTH 65536
+#define GOLDEN_COLUMNS     4096
+#define GOLDEN_METRICS     32
+
+/* splits a CSV line into its fields in place. Returns the number of fields */
+static unsigned int golden_split(char * line, char ** field, unsigned int max)
+{
+    unsigned int n = 0;
+    char * p = line;
+
+    line[strcspn(line, "\r\n")] = 0;
+    while (n < max) {
+        field[n++] = p;
+        p = strchr(p, ',');
+        if (p == NULL) break;
+        *p++ = 0;
+    }
+    return n;
+}
+
+static int golden_equal(double reference, double candidate, double rtol, double atol)
+{
+    if (isnan(reference) || isnan(candidate)) {
+        return (isnan(reference) && isnan(candidate));
+    }
+    return (fabs(reference - candidate) <= atol + rtol * fabs(reference));
+}
+
+typedef struct
+{
+    char header[GOLDEN_LINE_LENGTH];
+    char line[2][GOLDEN_LINE_LENGTH];
+    char * name[GOLDEN_COLUMNS];
+    char * field[2][GOLDEN_COLUMNS];
+} GoldenBuffers;
+
+static int golden_compare_files(FILE ** fp, GoldenBuffers * g,
+                                double rtol, double atol, FILE * report)
+{
+    unsigned int columns, c, n, row = 0;
+    double a, b;
+
+    /* the column names must match */
+    if ((fgets(g->header, GOLDEN_LINE_LENGTH, fp[0]) == NULL) ||
+        (fgets(g->line[1], GOLDEN_LINE_LENGTH, fp[1]) == NULL) ||
+        (strcmp(g->header, g->line[1]) != 0)) {
+        fprintf(report, "The columns differ\n");
+        return -1;
+    }
+    columns = golden_split(g->header, g->name, GOLDEN_COLUMNS);
+
+    while (1) {
+        n = (fgets(g->line[0], GOLDEN_LINE_LENGTH, fp[0]) != NULL);
+        n += (fgets(g->line[1], GOLDEN_LINE_LENGTH, fp[1]) != NULL);
+        if (n == 0) break;
+        if (n == 1) {
+            fprintf(report, "Different number of ticks after %u\n", row);
+            return 1;
+        }
+        row++;
+        if ((golden_split(g->line[0], g->field[0], columns) != columns) ||
+            (golden_split(g->line[1], g->field[1], columns) != columns)) {
+            fprintf(report, "Incomplete row %u\n", row);
+            return -1;
+        }
+        for (c = 0; c < columns; c++) {
+            a = strtod(g->field[0][c], NULL);
+            b = strtod(g->field[1][c], NULL);
+            if (!golden_equal(a, b, rtol, atol)) {
+                fprintf(report, "Diverged at tick %s, %s: reference %.9g, candidate %.9g\n",
+                        g->field[0][0], g->name[c], a, b);
+                return 1;
+            }
+        }
+    }
+    fprintf(report, "%u ticks match within rtol %g, atol %g\n", row, rtol, atol);
+    return 0;
+}
+
+typedef int (*GoldenFunction)(FILE ** fp, GoldenBuffers * g, void * arg, FILE * report);
+
+/* opens both files and runs the given comparison over them */
+static int golden_files(const char * reference, const char * candidate,
+                        GoldenFunction function, void * arg, FILE * report)
+{
+    FILE * fp[2];
+    GoldenBuffers * g;
+    int retval = -1;
+
+    fp[0] = fopen(reference, "r");
+    fp[1] = fopen(candidate, "r");
+    g = (GoldenBuffers*)malloc(sizeof(GoldenBuffers));
+    if ((fp[0] != NULL) && (fp[1] != NULL) && (g != NULL)) {
+        retval = function(fp, g, arg, report);
+    }
+    else {
+        fprintf(report, "Unable to read %s and %s\n", reference, candidate);
+    }
+    if (fp[0] != NULL) fclose(fp[0]);
+    if (fp[1] != NULL) fclose(fp[1]);
+    free(g);
+    return retval;
+}
+
+typedef struct
+{
+    double rtol, atol;
+} GoldenTolerance;
+
+static int golden_compare_ticks(FILE ** fp, GoldenBuffers * g, void * arg, FILE * report)
+{
+    GoldenTolerance * tolerance = (GoldenTolerance*)arg;
+
+    return golden_compare_files(fp, g, tolerance->rtol, tolerance->atol, report);
+}
+
+/* Compares a candidate time series file against a reference one, which
+   must have the same columns. Returns zero if every value is within
+   tolerance, one if they diverge and -1 on error */
+int golden_compare(const char * reference, const char * candidate,
+                   double rtol, double atol, FILE * report)
+{
+    GoldenTolerance tolerance;
+
+    tolerance.rtol = rtol;
+    tolerance.atol = atol;
+    return golden_files(reference, candidate, golden_compare_ticks, &tolerance, report);
+}
+
+typedef struct
+{
+    char name[64];
+    double rtol, atol;
+    unsigned int columns;
+    double total[2], sum[2], low, high;
+} GoldenMetric;
+
+typedef struct
+{
+    GoldenMetric metric[GOLDEN_METRICS];
+    unsigned int metrics, warmup;
+} GoldenMeans;
+
+static int golden_tolerance(const char * text, double * value)
+{
+    char * end;
+
+    *value = strtod(text, &end);
+    return ((end == text) || (*end != 0) || !(*value >= 0)) ? -1 : 0;
+}
+
+/* parses a comma separated list of metric=rtol[:atol] */
+static int golden_parse_tolerances(const char * spec, GoldenMeans * means)
+{
+    char tolerances[1024], * entry, * rtol, * atol, * saveptr;
+    GoldenMetric * m;
+
+    means->metrics = 0;
+    if (strlen(spec) >= sizeof(tolerances)) return -1;
+    strcpy(tolerances, spec);
+    for (entry = strtok_r(tolerances, ",", &saveptr); entry != NULL;
+         entry = strtok_r(NULL, ",", &saveptr)) {
+        if (means->metrics == GOLDEN_METRICS) return -1;
+        m = &means->metric[means->metrics++];
+        rtol = strchr(entry, '=');
+        if ((rtol == NULL) || (rtol == entry) ||
+            ((size_t)(rtol - entry) >= sizeof(m->name))) return -1;
+        *rtol++ = 0;
+        strcpy(m->name, entry);
+        m->atol = 0;
+        atol = strchr(rtol, ':');
+        if (atol != NULL) {
+            *atol++ = 0;
+            if (golden_tolerance(atol, &m->atol) != 0) return -1;
+        }
+        if (golden_tolerance(rtol, &m->rtol) != 0) return -1;
+    }
+    return (means->metrics > 0) ? 0 : -1;
+}
+
+/* returns the metric which a column belongs to, or -1. Columns are named
+   after their metric followed by the location, product or bank */
+static int golden_metric(GoldenMeans * means, const char * column)
+{
+    unsigned int i;
+    size_t length;
+
+    for (i = 0; i < means->metrics; i++) {
+        length = strlen(means->metric[i].name);
+        if ((strncmp(column, means->metric[i].name, length) == 0) &&
+            ((column[length] == 0) || (column[length] == '_'))) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int golden_compare_means_files(FILE ** fp, GoldenBuffers * g, void * arg, FILE * report)
+{
+    GoldenMeans * means = (GoldenMeans*)arg;
+    GoldenMetric * m;
+    int column_metric[GOLDEN_COLUMNS];
+    unsigned int columns, c, i, f, n, row = 0, rows = 0;
+    int retval = 0;
+
+    if ((fgets(g->header, GOLDEN_LINE_LENGTH, fp[0]) == NULL) ||
+        (fgets(g->line[1], GOLDEN_LINE_LENGTH, fp[1]) == NULL) ||
+        (strcmp(g->header, g->line[1]) != 0)) {
+        fprintf(report, "The columns differ\n");
+        return -1;
+    }
+    columns = golden_split(g->header, g->name, GOLDEN_COLUMNS);
+    for (c = 1; c < columns; c++) {
+        column_metric[c] = golden_metric(means, g->name[c]);
+        if (column_metric[c] >= 0) means->metric[column_metric[c]].columns++;
+    }
+    for (i = 0; i < means->metrics; i++) {
+        if (means->metric[i].columns == 0) {
+            fprintf(report, "No columns for %s\n", means->metric[i].name);
+            return -1;
+        }
+    }
+
+    while (1) {
+        n = (fgets(g->line[0], GOLDEN_LINE_LENGTH, fp[0]) != NULL);
+        n += (fgets(g->line[1], GOLDEN_LINE_LENGTH, fp[1]) != NULL);
+        if (n == 0) break;
+        if (n == 1) {
+            fprintf(report, "Different number of ticks after %u\n", row);
+            return 1;
+        }
+        row++;
+        if ((golden_split(g->line[0], g->field[0], columns) != columns) ||
+            (golden_split(g->line[1], g->field[1], columns) != columns)) {
+            fprintf(report, "Incomplete row %u\n", row);
+            return -1;
+        }
+        if (row <= means->warmup) continue;
+
+        for (i = 0; i < means->metrics; i++) {
+            means->metric[i].total[0] = 0;
+            means->metric[i].total[1] = 0;
+        }
+        for (c = 1; c < columns; c++) {
+            if (column_metric[c] < 0) continue;
+            m = &means->metric[column_metric[c]];
+            for (f = 0; f < 2; f++) {
+                m->total[f] += strtod(g->field[f][c], NULL);
+            }
+        }
+        for (i = 0; i < means->metrics; i++) {
+            m = &means->metric[i];
+            if ((rows == 0) || (m->total[0] < m->low)) m->low = m->total[0];
+            if ((rows == 0) || (m->total[0] > m->high)) m->high = m->total[0];
+            m->sum[0] += m->total[0];
+            m->sum[1] += m->total[1];
+        }
+        rows++;
+    }
+    if (rows == 0) {
+        fprintf(report, "No ticks after a warm-up of %u\n", means->warmup);
+        return -1;
+    }
+
+    for (i = 0; i < means->metrics; i++) {
+        m = &means->metric[i];
+        m->sum[0] /= rows;
+        m->sum[1] /= rows;
+        if (m->low == m->high) {
+            fprintf(report, "%s is constant in the reference\n", m->name);
+            retval = 1;
+        }
+        else if (!golden_equal(m->sum[0], m->sum[1], m->rtol, m->atol)) {
+            fprintf(report, "%s differs: reference mean %.9g, candidate mean %.9g, rtol %g, atol %g\n",
+                    m->name, m->sum[0], m->sum[1], m->rtol, m->atol);
+            retval = 1;
+        }
+        else {
+            fprintf(report, "%s matches: reference mean %.9g, candidate mean %.9g\n",
+                    m->name, m->sum[0], m->sum[1]);
+        }
+    }
+    fprintf(report, "Means of %u ticks after a warm-up of %u compared\n", rows, means->warmup);
+    return retval;
+}
+
+/* Compares the means of each metric in the given list of metric=rtol[:atol]
+   after the first warmup ticks. Returns zero if every mean is within its
+   tolerance and varies in the reference, one if not and -1 on error */
+int golden_compare_means(const char * reference, const char * candidate,
+                         const char * tolerances, unsigned int warmup, FILE * report)
+{
+    GoldenMeans * means = (GoldenMeans*)calloc(1, sizeof(GoldenMeans));
+    int retval = -1;
+
+    if (means == NULL) return -1;
+    if (golden_parse_tolerances(tolerances, means) != 0) {
+        fprintf(report, "Expected metric=rtol[:atol],... in %s\n", tolerances);
+    }
+    else {
+        means->warmup = warmup;
+        retval = golden_files(reference, candidate, golden_compare_means_files, means, report);
+    }
+    free(means);
+    return retval;
+}
@@ -0,0 +1,383 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Hashing of the economy's state, used to find where two runs which
+   ought to agree first part company. Every float is quantised to a
+   given number of significant bits before it is hashed, so that runs
+   whose arithmetic differs only in the last few bits can still be
+   compared. Derived structures such as the market books are rebuilt
+   from the entities and so are not hashed */
+
+#include "econ.h"
+
+#define HASH_MAX_DUMP 20
+
+static uint64_t hash_mix(uint64_t h, uint64_t v)
+{
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+/* hashes a value rounded to the given number of significant bits */
+static uint64_t hash_value(uint64_t h, double x, unsigned int bits)
+{
+    int exponent;
+    int64_t mantissa;
+    double m;
+
+    if ((x == 0) || (!isfinite(x))) return hash_mix(h, (x == 0) ? 0 : (uint64_t)isinf(x) + 1);
+
+    m = frexp(x, &exponent);
+    mantissa = (int64_t)nearbyint(ldexp(m, (int)bits));
+    /* rounding up may carry into the next power of two */
+    if ((mantissa == ((int64_t)1 << bits)) || (mantissa == -((int64_t)1 << bits))) {
+        mantissa /= 2;
+        exponent++;
+    }
+    return hash_mix(hash_mix(h, (uint64_t)mantissa), (uint64_t)(int64_t)exponent);
+}
+
+static uint64_t hash_capital(uint64_t h, Capital * c, unsigned int bits)
+{
+    unsigned int i;
+
+    h = hash_value(h, c->repayment_per_month, bits);
+    h = hash_value(h, c->variable, bits);
+    h = hash_value(h, c->constant, bits);
+    h = hash_value(h, c->surplus, bits);
+    h = hash_value(h, c->fictitious, bits);
+    for (i = 0; i < MAX_HISTORY_STEPS; i++) {
+        h = hash_value(h, c->surplus_history[i], bits);
+    }
+    return hash_value(h, c->savings_rate, bits);
+}
+
+static uint64_t hash_firm(Firm * f, unsigned int bits)
+{
+    uint64_t h = hash_mix(ENTITY_FIRM, f->location);
+    unsigned int i;
+
+    h = hash_capital(h, &f->capital, bits);
+    h = hash_mix(h, f->labour.days_per_week);
+    h = hash_value(h, f->labour.time_total, bits);
+    h = hash_value(h, f->labour.time_necessary, bits);
+    h = hash_mix(h, f->labour.workers);
+    h = hash_value(h, f->labour.wage_rate, bits);
+    h = hash_value(h, f->labour.productivity, bits);
+    h = hash_mix(h, f->labour.is_recruiting);
+    for (i = 0; i < PROCESS_INPUTS; i++) {
+        h = hash_mix(h, f->process.raw_material[i]);
+        h = hash_value(h, f->process.raw_material_stock[i], bits);
+    }
+    h = hash_mix(h, f->process.product_type);
+    h = hash_value(h, f->process.stock, bits);
+    return hash_value(h, f->sale_value, bits);
+}
+
+static uint64_t hash_account(Account * a, unsigned int bits)
+{
+    uint64_t h = hash_mix(a->entity_type, a->entity_index);
+
+    h = hash_value(h, a->balance, bits);
+    h = hash_value(h, a->loan, bits);
+    h = hash_value(h, a->loan_interest_rate, bits);
+    h = hash_mix(h, a->loan_elapsed_days);
+    h = hash_value(h, a->loan_repaid, bits);
+    h = hash_value(h, a->loan_repayment_per_month, bits);
+    h = hash_value(h, a->loan_due, bits);
+    h = hash_value(h, a->loan_accrual, bits);
+    h = hash_mix(h, a->loan_accrual_days);
+    return hash_mix(h, a->loan_check_day);
+}
+
+static uint64_t hash_bank(Bank * b, unsigned int bits)
+{
+    uint64_t h = hash_mix(ENTITY_BANK, b->tax_location);
+    unsigned int i;
+
+    h = hash_capital(h, &b->capital, bits);
+    h = hash_value(h, b->interest_deposit, bits);
+    h = hash_value(h, b->interest_loan, bits);
+    h = hash_mix(h, b->active_accounts);
+    /* closed slots keep whatever they last held, so only open
+       accounts are hashed, along with the slots they occupy */
+    for (i = 0; i < b->active_accounts; i++) {
+        h = hash_mix(h, b->live[i]);
+        h = hash_mix(h, hash_account(&b->account[b->live[i]], bits));
+    }
+    return h;
+}
+
+static uint64_t hash_state(State * s, unsigned int bits)
+{
+    uint64_t h = hash_mix(ENTITY_STATE, s->population);
+
+    h = hash_capital(h, &s->capital, bits);
+    h = hash_value(h, s->VAT_rate, bits);
+    h = hash_value(h, s->business_tax_rate, bits);
+    h = hash_mix(h, s->unemployed);
+    return hash_value(h, s->citizens_dividend, bits);
+}
+
+static uint64_t hash_merchant(Merchant * m, unsigned int bits)
+{
+    uint64_t h = hash_mix(ENTITY_MERCHANT, m->tax_location);
+    unsigned int i;
+
+    h = hash_capital(h, &m->capital, bits);
+    h = hash_value(h, m->interest_rate, bits);
+    h = hash_mix(h, m->hedge);
+    for (i = 0; i < MAX_PRODUCT_TYPES; i++) {
+        h = hash_value(h, m->stock[i], bits);
+        h = hash_value(h, m->price[i], bits);
+    }
+    return h;
+}
+
+static uint64_t hash_rentier(Rentier * r, unsigned int bits)
+{
+    uint64_t h = hash_mix(ENTITY_RENTIER, r->asset_type);
+
+    h = hash_capital(h, &r->capital, bits);
+    h = hash_value(h, r->asset_value, bits);
+    h = hash_value(h, r->rent_per_month, bits);
+    h = hash_mix(h, r->quantity);
+    return hash_mix(h, r->location);
+}
+
+/* returns a hash of the whole state of the economy, with floats rounded
+   to the given number of significant bits */
+uint64_t econ_hash(Economy * e, unsigned int bits)
+{
+    uint64_t h = hash_mix(e->tick, e->bankruptcies);
+    unsigned int i;
+
+    for (i = 0; i < e->size; i++) {
+        h = hash_mix(h, hash_firm(&e->firm[i], bits));
+    }
+    for (i = 0; i < e->banks; i++) {
+        h = hash_mix(h, hash_bank(&e->bank[i], bits));
+    }
+    for (i = 0; i < e->params.locations; i++) {
+        h = hash_mix(h, hash_state(&e->state[i], bits));
+    }
+    h = hash_mix(h, hash_merchant(&e->merchant, bits));
+    for (i = 0; i < e->rentiers; i++) {
+        h = hash_mix(h, hash_rentier(&e->rentier[i], bits));
+    }
+    return h;
+}
+
+/* adds the hash of the state after a phase to the rolling hash */
+void econ_hash_phase(Economy * e, unsigned int phase)
+{
+    e->phase_hash[phase] = econ_hash(e, e->hash_bits);
+    e->hash = hash_mix(e->hash, e->phase_hash[phase]);
+}
+
+static void hash_dump_capital(Capital * c, FILE * fp)
+{
+    fprintf(fp, " repayment %.9g variable %.9g constant %.9g surplus %.9g fictitious %.9g savings %.9g",
+            c->repayment_per_month, c->variable, c->constant,
+            c->surplus, c->fictitious, c->savings_rate);
+}
+
+static void hash_dump_firm(Firm * f, FILE * fp)
+{
+    hash_dump_capital(&f->capital, fp);
+    fprintf(fp, " location %u workers %u days %u time %.9g/%.9g wage %.9g productivity %.9g",
+            f->location, f->labour.workers, f->labour.days_per_week,
+            f->labour.time_necessary, f->labour.time_total,
+            f->labour.wage_rate, f->labour.productivity);
+    fprintf(fp, " product %u stock %.9g inputs %.9g %.9g sale %.9g\n",
+            f->process.product_type, f->process.stock,
+            f->process.raw_material_stock[0], f->process.raw_material_stock[1],
+            f->sale_value);
+}
+
+static void hash_dump_account(Account * a, FILE * fp)
+{
+    fprintf(fp, " entity %u/%u balance %.9g loan %.9g rate %.9g days %u repaid %.9g repayment %.9g due %.9g",
+            a->entity_type, a->entity_index, a->balance, a->loan,
+            a->loan_interest_rate, a->loan_elapsed_days,
+            a->loan_repaid, a->loan_repayment_per_month, a->loan_due);
+    fprintf(fp, " accrual %.9g/%u check %u\n",
+            a->loan_accrual, a->loan_accrual_days, a->loan_check_day);
+}
+
+static void hash_dump_state(State * s, FILE * fp)
+{
+    hash_dump_capital(&s->capital, fp);
+    fprintf(fp, " VAT %.9g tax %.9g population %u unemployed %u dividend %.9g\n",
+            s->VAT_rate, s->business_tax_rate, s->population,
+            s->unemployed, s->citizens_dividend);
+}
+
+static void hash_dump_merchant(Merchant * m, FILE * fp)
+{
+    unsigned int i;
+
+    hash_dump_capital(&m->capital, fp);
+    for (i = 0; i < MAX_PRODUCT_TYPES; i++) {
+        fprintf(fp, " stock %.9g price %.9g", m->stock[i], m->price[i]);
+    }
+    fprintf(fp, "\n");
+}
+
+static void hash_dump_rentier(Rentier * r, FILE * fp)
+{
+    hash_dump_capital(&r->capital, fp);
+    fprintf(fp, " asset %u value %.9g rent %.9g quantity %u location %u\n",
+            r->asset_type, r->asset_value, r->rent_per_month,
+            r->quantity, r->location);
+}
+
+/* prints a pair of entities which differ, up to a limit */
+#define HASH_DUMP(count, fp, kind, index, a, b, dump) \
+    do { \
+        if ((count)++ < HASH_MAX_DUMP) { \
+            fprintf(fp, "%s %u a:", kind, index); dump(a, fp); \
+            fprintf(fp, "%s %u b:", kind, index); dump(b, fp); \
+        } \
+    } while (0)
+
+/* prints the entities whose state differs between two economies of the
+   same size. Returns the number which differ */
+unsigned int econ_hash_diff(Economy * a, Economy * b, unsigned int bits, FILE * fp)
+{
+    unsigned int i, j, count = 0;
+
+    if ((a->size != b->size) || (a->banks != b->banks) ||
+        (a->rentiers != b->rentiers) || (a->params.locations != b->params.locations)) {
+        fprintf(fp, "The economies are of different sizes\n");
+        return 1;
+    }
+    for (i = 0; i < a->size; i++) {
+        if (hash_firm(&a->firm[i], bits) == hash_firm(&b->firm[i], bits)) continue;
+        HASH_DUMP(count, fp, "firm", i, &a->firm[i], &b->firm[i], hash_dump_firm);
+    }
+    for (i = 0; i < a->banks; i++) {
+        if (hash_bank(&a->bank[i], bits) == hash_bank(&b->bank[i], bits)) continue;
+        if (count++ < HASH_MAX_DUMP) {
+            fprintf(fp, "bank %u a:", i);
+            hash_dump_capital(&a->bank[i].capital, fp);
+            fprintf(fp, " deposit %.9g loan %.9g accounts %u\n",
+                    a->bank[i].interest_deposit, a->bank[i].interest_loan,
+                    a->bank[i].active_accounts);
+            fprintf(fp, "bank %u b:", i);
+            hash_dump_capital(&b->bank[i].capital, fp);
+            fprintf(fp, " deposit %.9g loan %.9g accounts %u\n",
+                    b->bank[i].interest_deposit, b->bank[i].interest_loan,
+                    b->bank[i].active_accounts);
+        }
+        for (j = 0; (j < a->bank[i].max_accounts) && (j < b->bank[i].max_accounts); j++) {
+            if (bank_account_defunct(&a->bank[i].account[j]) &&
+                bank_account_defunct(&b->bank[i].account[j])) continue;
+            if (hash_account(&a->bank[i].account[j], bits) ==
+                hash_account(&b->bank[i].account[j], bits)) continue;
+            if (count++ >= HASH_MAX_DUMP) continue;
+            fprintf(fp, "bank %u account %u a:", i, j);
+            hash_dump_account(&a->bank[i].account[j], fp);
+            fprintf(fp, "bank %u account %u b:", i, j);
+            hash_dump_account(&b->bank[i].account[j], fp);
+        }
+    }
+    for (i = 0; i < a->params.locations; i++) {
+        if (hash_state(&a->state[i], bits) == hash_state(&b->state[i], bits)) continue;
+        HASH_DUMP(count, fp, "state", i, &a->state[i], &b->state[i], hash_dump_state);
+    }
+    if (hash_merchant(&a->merchant, bits) != hash_merchant(&b->merchant, bits)) {
+        HASH_DUMP(count, fp, "merchant", 0, &a->merchant, &b->merchant, hash_dump_merchant);
+    }
+    for (i = 0; i < a->rentiers; i++) {
+        if (hash_rentier(&a->rentier[i], bits) == hash_rentier(&b->rentier[i], bits)) continue;
+        HASH_DUMP(count, fp, "rentier", i, &a->rentier[i], &b->rentier[i], hash_dump_rentier);
+    }
+    if (a->bankruptcies != b->bankruptcies) {
+        fprintf(fp, "bankruptcies a: %u b: %u\n", a->bankruptcies, b->bankruptcies);
+        count++;
+    }
+    if (count > HASH_MAX_DUMP) {
+        fprintf(fp, "%u more differences\n", count - HASH_MAX_DUMP);
+    }
+    return count;
+}
+
+/* runs economies with two configurations side by side, a phase at a time,
+   and stops at the first phase after which their states differ. Returns
+   zero if they agree throughout, one if they diverge and -1 on error */
+int bisect_run(EconomyConfig * config_a, EconomyConfig * config_b,
+               unsigned int ticks, unsigned int bits, FILE * fp)
+{
+    Economy * e[2];
+    unsigned int tick, phase, i;
+    int retval = 0;
+
+    e[0] = econ_create(config_a);
+    e[1] = econ_create(config_b);
+    if ((e[0] == NULL) || (e[1] == NULL)) {
+        if (e[0] != NULL) econ_destroy(e[0]);
+        if (e[1] != NULL) econ_destroy(e[1]);
+        return -1;
+    }
+
+    if (econ_hash(e[0], bits) != econ_hash(e[1], bits)) {
+        fprintf(fp, "Diverged on creation\n");
+        econ_hash_diff(e[0], e[1], bits, fp);
+        retval = 1;
+    }
+
+    for (i = 0; i < 2; i++) {
+        e[i]->hash_bits = bits;
+    }
+    for (tick = 0; (tick < ticks) && (retval == 0); tick++) {
+        for (phase = 0; phase < PHASES; phase++) {
+            for (i = 0; i < 2; i++) {
+                econ_step(e[i], phase, 1);
+            }
+            if (e[0]->phase_hash[phase] == e[1]->phase_hash[phase]) continue;
+            fprintf(fp, "Diverged at tick %u, phase %s\n",
+                    e[0]->tick, econ_phase_name(phase));
+            econ_hash_diff(e[0], e[1], bits, fp);
+            retval = 1;
+            break;
+        }
+    }
+    if (retval == 0) {
+        fprintf(fp, "%u ticks agree to %u bits\n", ticks, bits);
+    }
+
+    econ_destroy(e[0]);
+    econ_destroy(e[1]);
+    return retval;
+}
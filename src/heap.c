@@ -0,0 +1,197 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Indexed binary min-heap of items keyed on a float value. Equal keys
+   are ordered by item number, so that the top of the heap is the same
+   as would be found by a linear scan for the first smallest value.
+   The position of each item within the heap is kept in an array which
+   may be shared between several heaps, provided that any item only
+   appears in one of them at a time */
+
+#include "econ.h"
+
+static int heap_less(Heap * h, unsigned int a, unsigned int b)
+{
+    if (h->key[a] < h->key[b]) return 1;
+    if (h->key[a] > h->key[b]) return 0;
+    return (h->item[a] < h->item[b]);
+}
+
+static void heap_swap(Heap * h, int * position, unsigned int a, unsigned int b)
+{
+    unsigned int item = h->item[a];
+    float key = h->key[a];
+
+    h->item[a] = h->item[b];
+    h->key[a] = h->key[b];
+    h->item[b] = item;
+    h->key[b] = key;
+    position[h->item[a]] = (int)a;
+    position[h->item[b]] = (int)b;
+}
+
+static void heap_sift_up(Heap * h, int * position, unsigned int i)
+{
+    unsigned int parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (!heap_less(h, i, parent)) break;
+        heap_swap(h, position, i, parent);
+        i = parent;
+    }
+}
+
+static void heap_sift_down(Heap * h, int * position, unsigned int i)
+{
+    unsigned int child, smallest;
+
+    while (1) {
+        smallest = i;
+        child = i*2 + 1;
+        if ((child < h->length) && heap_less(h, child, smallest)) {
+            smallest = child;
+        }
+        child++;
+        if ((child < h->length) && heap_less(h, child, smallest)) {
+            smallest = child;
+        }
+        if (smallest == i) break;
+        heap_swap(h, position, i, smallest);
+        i = smallest;
+    }
+}
+
+void heap_init(Heap * h)
+{
+    h->length = 0;
+    h->capacity = 0;
+    h->item = NULL;
+    h->key = NULL;
+}
+
+void heap_free(Heap * h)
+{
+    free(h->item);
+    free(h->key);
+    heap_init(h);
+}
+
+/* empties the heap without releasing its storage */
+void heap_clear(Heap * h, int * position)
+{
+    unsigned int i;
+
+    for (i = 0; i < h->length; i++) {
+        position[h->item[i]] = -1;
+    }
+    h->length = 0;
+}
+
+/* makes room for at least the given number of items, so that inserting
+   up to that many cannot fail. Returns zero on success */
+int heap_reserve(Heap * h, unsigned int capacity)
+{
+    unsigned int * new_item;
+    float * new_key;
+
+    if (capacity <= h->capacity) return 0;
+    new_item = (unsigned int*)realloc(h->item, capacity*sizeof(unsigned int));
+    if (new_item == NULL) return -1;
+    h->item = new_item;
+    new_key = (float*)realloc(h->key, capacity*sizeof(float));
+    if (new_key == NULL) return -1;
+    h->key = new_key;
+    h->capacity = capacity;
+    return 0;
+}
+
+int heap_insert(Heap * h, int * position, unsigned int item, float key)
+{
+    if ((h->length == h->capacity) &&
+        (heap_reserve(h, (h->capacity == 0) ? 16 : h->capacity*2) != 0)) {
+        return -1;
+    }
+    h->item[h->length] = item;
+    h->key[h->length] = key;
+    position[item] = (int)h->length;
+    h->length++;
+    heap_sift_up(h, position, h->length - 1);
+    return 0;
+}
+
+void heap_remove(Heap * h, int * position, unsigned int item)
+{
+    int i = position[item];
+    unsigned int moved;
+
+    if (i < 0) return;
+    position[item] = -1;
+    h->length--;
+    if ((unsigned int)i == h->length) return;
+
+    /* move the last item into the gap */
+    moved = h->item[h->length];
+    h->item[i] = moved;
+    h->key[i] = h->key[h->length];
+    position[moved] = i;
+    heap_sift_up(h, position, (unsigned int)i);
+    heap_sift_down(h, position, (unsigned int)position[moved]);
+}
+
+void heap_update(Heap * h, int * position, unsigned int item, float key)
+{
+    int i = position[item];
+
+    if (i < 0) return;
+    h->key[i] = key;
+    heap_sift_up(h, position, (unsigned int)i);
+    heap_sift_down(h, position, (unsigned int)position[item]);
+}
+
+/* returns the item at the top of the heap, or -1 if empty */
+int heap_top(Heap * h)
+{
+    if (h->length == 0) return -1;
+    return (int)h->item[0];
+}
+
+/* returns the top item other than the one given. Because the
+   excluded item can only be at the root, the next best is one of
+   its children */
+int heap_top_excluding(Heap * h, unsigned int item)
+{
+    if (h->length == 0) return -1;
+    if (h->item[0] != item) return (int)h->item[0];
+    if (h->length == 1) return -1;
+    if ((h->length == 2) || heap_less(h, 1, 2)) return (int)h->item[1];
+    return (int)h->item[2];
+}
@@ -0,0 +1,450 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+#include <unistd.h>
+#include "econ.h"
+
+static int parse_arg(int argc, char* argv[], int * i, unsigned int * value)
+{
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "Missing value for %s\n", argv[*i]);
+        return -1;
+    }
+    *i = *i + 1;
+    *value = (unsigned int)atoi(argv[*i]);
+    return 0;
+}
+
+/* parses a name=value pair for one of the runtime parameters */
+static int parse_param(int argc, char* argv[], int * i, Params * params)
+{
+    char name[64];
+    const char * value;
+    const ParamInfo * info;
+    size_t length;
+
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "Missing value for %s\n", argv[*i]);
+        return -1;
+    }
+    *i = *i + 1;
+    value = strchr(argv[*i], '=');
+    length = (value != NULL) ? (size_t)(value - argv[*i]) : 0;
+    if ((length == 0) || (length >= sizeof(name))) {
+        fprintf(stderr, "Expected name=value for %s\n", argv[*i - 1]);
+        return -1;
+    }
+    memcpy(name, argv[*i], length);
+    name[length] = 0;
+    info = params_find(name);
+    if (info == NULL) {
+        fprintf(stderr, "Unknown parameter %s\n", name);
+        return -1;
+    }
+    params_set(params, info, atof(value + 1));
+    return 0;
+}
+
+static int parse_string(int argc, char* argv[], int * i, const char ** value)
+{
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "Missing value for %s\n", argv[*i]);
+        return -1;
+    }
+    *i = *i + 1;
+    *value = argv[*i];
+    return 0;
+}
+
+/* parses a tolerance, which must be a non-negative number */
+static int parse_tolerance(int argc, char* argv[], int * i, double * value)
+{
+    char * end;
+
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "Missing value for %s\n", argv[*i]);
+        return -1;
+    }
+    *i = *i + 1;
+    *value = strtod(argv[*i], &end);
+    if ((end == argv[*i]) || (*end != 0) || !(*value >= 0)) {
+        fprintf(stderr, "Expected a non-negative number for %s\n", argv[*i - 1]);
+        return -1;
+    }
+    return 0;
+}
+
+static const char * tick_mode_names[] = { "serial", "phased", "parallel" };
+
+/* returns the tick mode with the given name, or -1 */
+static int tick_mode_find(const char * name)
+{
+    unsigned int mode;
+
+    for (mode = 0; mode < TICK_MODES; mode++) {
+        if (strcmp(name, tick_mode_names[mode]) == 0) return (int)mode;
+    }
+    return -1;
+}
+
+static int parse_tick_mode(int argc, char* argv[], int * i, unsigned int * value)
+{
+    int mode;
+
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "Missing value for %s\n", argv[*i]);
+        return -1;
+    }
+    *i = *i + 1;
+    mode = tick_mode_find(argv[*i]);
+    if (mode < 0) {
+        fprintf(stderr, "Unknown tick mode %s\n", argv[*i]);
+        return -1;
+    }
+    *value = (unsigned int)mode;
+    return 0;
+}
+
+/* applies a comma separated list of tick=mode, threads=N and simd=0|1
+   settings, which describe the second configuration when bisecting */
+static int parse_bisect(const char * spec, EconomyConfig * config)
+{
+    char settings[256], * setting, * value, * saveptr;
+    int mode;
+
+    if (strlen(spec) >= sizeof(settings)) return -1;
+    strcpy(settings, spec);
+    for (setting = strtok_r(settings, ",", &saveptr); setting != NULL;
+         setting = strtok_r(NULL, ",", &saveptr)) {
+        value = strchr(setting, '=');
+        if (value == NULL) break;
+        *value++ = 0;
+        if (strcmp(setting, "tick") == 0) {
+            mode = tick_mode_find(value);
+            if (mode < 0) break;
+            config->tick_mode = (unsigned int)mode;
+        }
+        else if (strcmp(setting, "threads") == 0) {
+            config->threads = (unsigned int)atoi(value);
+        }
+        else if (strcmp(setting, "simd") == 0) {
+            config->simd = atoi(value);
+        }
+        else {
+            break;
+        }
+    }
+    if (setting != NULL) {
+        fprintf(stderr, "Expected tick=mode, threads=N or simd=0|1 in %s\n", spec);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    Economy * e;
+    EconomyConfig config;
+    unsigned int i, j, ticks = 100, seed, runs = 0;
+    const char * sweep = NULL, * load = NULL, * save = NULL, * scenarios = NULL;
+    const char * series_file = NULL, * metrics = NULL;
+    const char * compare[2] = { NULL, NULL }, * tolerances = NULL;
+    double rtol = 1e-6, atol = 1e-9;
+    unsigned int warmup = 0;
+    const char * bisect = NULL;
+    EconomyConfig bisect_config;
+    unsigned int hash_bits = 0;
+    unsigned int branches = 0;
+    int quiet = 0;
+    /* whether the way of ticking was given, which overrides a checkpoint */
+    int tick_set = 0, simd_set = 0, threads_set = 0;
+    /* the last option given which only applies to a new economy */
+    const char * create_option = NULL;
+#ifdef ECON_PROFILE
+    int profile = 0;
+#endif
+    Series * series = NULL;
+    int retval;
+    int a;
+
+    econ_config_init(&config);
+    for (a = 1; a < argc; a++) {
+        if ((strcmp(argv[a], "-n") == 0) || (strcmp(argv[a], "--size") == 0)) {
+            if (parse_arg(argc, argv, &a, &config.size) != 0) return 1;
+            create_option = argv[a-1];
+        }
+        else if (strcmp(argv[a], "--banks") == 0) {
+            if (parse_arg(argc, argv, &a, &config.banks) != 0) return 1;
+            create_option = argv[a-1];
+        }
+        else if (strcmp(argv[a], "--accounts") == 0) {
+            if (parse_arg(argc, argv, &a, &config.accounts) != 0) return 1;
+            create_option = argv[a-1];
+        }
+        else if (strcmp(argv[a], "--rentiers") == 0) {
+            if (parse_arg(argc, argv, &a, &config.rentiers) != 0) return 1;
+            create_option = argv[a-1];
+        }
+        else if (strcmp(argv[a], "--tick") == 0) {
+            if (parse_tick_mode(argc, argv, &a, &config.tick_mode) != 0) return 1;
+            tick_set = 1;
+        }
+        else if (strcmp(argv[a], "--seed") == 0) {
+            if (parse_arg(argc, argv, &a, &seed) != 0) return 1;
+            config.seed = seed;
+            create_option = argv[a-1];
+        }
+        else if (strcmp(argv[a], "--threads") == 0) {
+            if (parse_arg(argc, argv, &a, &config.threads) != 0) return 1;
+            threads_set = 1;
+        }
+        else if (strcmp(argv[a], "--no-simd") == 0) {
+            config.simd = 0;
+            simd_set = 1;
+        }
+        else if (strcmp(argv[a], "--ensemble") == 0) {
+            if (parse_arg(argc, argv, &a, &runs) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--param") == 0) {
+            if (parse_param(argc, argv, &a, &config.params) != 0) return 1;
+            create_option = argv[a-1];
+        }
+        else if (strcmp(argv[a], "--sweep") == 0) {
+            if (parse_string(argc, argv, &a, &sweep) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--scenarios") == 0) {
+            if (parse_string(argc, argv, &a, &scenarios) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--branches") == 0) {
+            if (parse_arg(argc, argv, &a, &branches) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--series") == 0) {
+            if (parse_string(argc, argv, &a, &series_file) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--metrics") == 0) {
+            if (parse_string(argc, argv, &a, &metrics) != 0) return 1;
+        }
+        else if ((strcmp(argv[a], "--profile") == 0) ||
+                 (strcmp(argv[a], "--perf") == 0)) {
+#ifdef ECON_PROFILE
+            /* hardware counters are also read with --perf */
+            if (profile == 0) profile = 1;
+            if (strcmp(argv[a], "--perf") == 0) profile = 2;
+#else
+            fprintf(stderr, "Profiling is not compiled in, use make profile\n");
+            return 1;
+#endif
+        }
+        else if (strcmp(argv[a], "--compare") == 0) {
+            if ((parse_string(argc, argv, &a, &compare[0]) != 0) ||
+                (parse_string(argc, argv, &a, &compare[1]) != 0)) return 1;
+        }
+        else if (strcmp(argv[a], "--rtol") == 0) {
+            if (parse_tolerance(argc, argv, &a, &rtol) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--atol") == 0) {
+            if (parse_tolerance(argc, argv, &a, &atol) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--tolerances") == 0) {
+            if (parse_string(argc, argv, &a, &tolerances) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--warmup") == 0) {
+            if (parse_arg(argc, argv, &a, &warmup) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--hash") == 0) {
+            if (hash_bits == 0) hash_bits = HASH_BITS;
+        }
+        else if (strcmp(argv[a], "--hash-bits") == 0) {
+            if (parse_arg(argc, argv, &a, &hash_bits) != 0) return 1;
+            if ((hash_bits == 0) || (hash_bits > MAX_HASH_BITS)) {
+                fprintf(stderr, "Hash bits should be between 1 and %d\n", MAX_HASH_BITS);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[a], "--bisect") == 0) {
+            if (parse_string(argc, argv, &a, &bisect) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--quiet") == 0) {
+            quiet = 1;
+        }
+        else if (strcmp(argv[a], "--load") == 0) {
+            if (parse_string(argc, argv, &a, &load) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--save") == 0) {
+            if (parse_string(argc, argv, &a, &save) != 0) return 1;
+        }
+        else if (strcmp(argv[a], "--ticks") == 0) {
+            if (parse_arg(argc, argv, &a, &ticks) != 0) return 1;
+        }
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[a]);
+            return 1;
+        }
+    }
+
+    /* compare a time series against a golden reference */
+    if ((compare[0] != NULL) && (tolerances != NULL)) {
+        return (golden_compare_means(compare[0], compare[1], tolerances,
+                                     warmup, stdout) == 0) ? 0 : 1;
+    }
+    if (compare[0] != NULL) {
+        return (golden_compare(compare[0], compare[1], rtol, atol, stdout) == 0) ? 0 : 1;
+    }
+
+    if (!params_valid(&config.params)) {
+        fprintf(stderr, "Invalid parameters\n");
+        return 1;
+    }
+
+    /* run a second configuration alongside and stop where they differ */
+    if (bisect != NULL) {
+        bisect_config = config;
+        if (parse_bisect(bisect, &bisect_config) != 0) return 1;
+        if (hash_bits == 0) hash_bits = HASH_BITS;
+        retval = bisect_run(&config, &bisect_config, ticks, hash_bits, stdout);
+        if (retval < 0) {
+            fprintf(stderr, "Unable to create economies of size %u\n", config.size);
+        }
+        return (retval == 0) ? 0 : 1;
+    }
+
+    /* in sweep and ensemble modes threads run separate economies */
+    if (sweep != NULL) {
+        if (sweep_run(&config, sweep, config.threads, ticks, stdout) != 0) {
+            fprintf(stderr, "Unable to complete the sweep\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    if (runs > 0) {
+        if (ensemble_run(&config, runs, config.threads, ticks, stdout) != 0) {
+            fprintf(stderr, "Unable to complete the ensemble\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    if (load != NULL) {
+        /* continue from a checkpoint, ticking in the same way as
+           before unless told otherwise */
+        if (create_option != NULL) {
+            fprintf(stderr, "%s cannot be used with --load, since the "
+                    "checkpoint defines the economy\n", create_option);
+            return 1;
+        }
+        e = econ_load(load);
+        if (e == NULL) {
+            fprintf(stderr, "Unable to load checkpoint %s\n", load);
+            return 1;
+        }
+        if (tick_set) e->tick_mode = config.tick_mode;
+        if (simd_set) e->simd = config.simd;
+        if (threads_set) e->threads = (config.threads > 0) ? config.threads : 1;
+    }
+    else {
+        e = econ_create(&config);
+        if (e == NULL) {
+            fprintf(stderr, "Unable to create an economy of size %u\n", config.size);
+            return 1;
+        }
+    }
+
+    /* each scenario branches from the economy in its own process */
+    if (scenarios != NULL) {
+        if (branches == 0) branches = (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+        retval = scenario_run(e, scenarios, branches, ticks, stdout);
+        econ_destroy(e);
+        if (retval != 0) {
+            fprintf(stderr, "Unable to complete the scenarios\n");
+            return 1;
+        }
+        return 0;
+    }
+
+#ifdef ECON_PROFILE
+    if ((profile == 2) && (profile_perf_open(&e->profile) != 0)) {
+        fprintf(stderr, "Hardware counters are unavailable\n");
+    }
+#endif
+
+    if (series_file != NULL) {
+        series = series_open(e, series_file, metrics);
+        if (series == NULL) {
+            fprintf(stderr, "Unable to open time series %s\n", series_file);
+            econ_destroy(e);
+            return 1;
+        }
+    }
+
+    e->hash_bits = hash_bits;
+    for (i = 0; i < ticks; i++)  {
+        econ_update(e, 1);
+        if (series != NULL) series_record(series, e);
+        if (quiet) continue;
+        if (hash_bits > 0) printf("Hash: %016llx\n", (unsigned long long)e->hash);
+        printf("Profit: %.2f\n",e->firm[0].capital.surplus);
+        printf("Bankrupt: %d/%d\n",e->bankruptcies,e->size);
+        printf("Unemployed: %d/%d\n",(int)e->state[0].unemployed,e->state[0].population);
+        printf("Merchant: ");
+        for (j = 0; j < MAX_PRODUCT_TYPES; j++)  {
+            printf("%d ", (int)e->merchant.stock[j]);
+        }
+        printf("\nBank: ");
+        for (j = 0; j < e->banks; j++)  {
+            printf("%.2f ", bank_worth(&e->bank[j]));
+        }
+        printf("\n");
+    }
+
+    if ((quiet) && (hash_bits > 0)) {
+        printf("Hash: %016llx\n", (unsigned long long)e->hash);
+    }
+
+#ifdef ECON_PROFILE
+    if (profile) profile_report(&e->profile, stderr);
+#endif
+
+    if ((series != NULL) && (series_close(series) != 0)) {
+        fprintf(stderr, "Unable to write time series %s\n", series_file);
+        econ_destroy(e);
+        return 1;
+    }
+
+    if ((save != NULL) && (econ_save(e, save) != 0)) {
+        fprintf(stderr, "Unable to save checkpoint %s\n", save);
+        econ_destroy(e);
+        return 1;
+    }
+
+    econ_destroy(e);
+    return 0;
+}
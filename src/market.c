@@ -0,0 +1,151 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Index of stock-weighted prices for each product type and location.
+   Each firm's contribution is remembered so that it can be replaced
+   whenever its price, stock or defunct status changes, which allows
+   average prices to be returned without scanning every firm.
+   Firms with stock are also held in an order book for their product
+   type and location, so that the best offer can be found quickly */
+
+#include "econ.h"
+
+/* Allocates the market for the given number of firms. Any firm could
+   end up in any book, so each book in use is given room for all of
+   them, and listing a firm can then never fail. Returns zero on success */
+int market_init(Market * m, unsigned int size, unsigned int locations)
+{
+    unsigned int i, l;
+
+    for (i = 0; i < MAX_PRODUCT_TYPES; i++) {
+        for (l = 0; l < MAX_LOCATIONS; l++) {
+            heap_init(&m->book[i][l]);
+        }
+    }
+    for (i = 0; i < MAX_PRODUCT_TYPES; i++) {
+        for (l = 0; l < locations; l++) {
+            if (heap_reserve(&m->book[i][l], size) != 0) return -1;
+        }
+    }
+    m->size = size;
+    m->entry = (MarketEntry*)calloc(size, sizeof(MarketEntry));
+    m->book_position = (int*)malloc(size*sizeof(int));
+    if ((m->entry == NULL) || (m->book_position == NULL)) return -1;
+    for (i = 0; i < size; i++) {
+        m->book_position[i] = -1;
+    }
+    memset(m->value, '\0', sizeof(m->value));
+    memset(m->stock, '\0', sizeof(m->stock));
+    return 0;
+}
+
+void market_free(Market * m)
+{
+    unsigned int i, l;
+
+    for (i = 0; i < MAX_PRODUCT_TYPES; i++) {
+        for (l = 0; l < MAX_LOCATIONS; l++) {
+            heap_free(&m->book[i][l]);
+        }
+    }
+    free(m->entry);
+    free(m->book_position);
+    m->entry = NULL;
+    m->book_position = NULL;
+}
+
+/* updates the contribution of the given firm to the market totals */
+void market_update(Economy * e, unsigned int index)
+{
+    Market * m = &e->market;
+    MarketEntry * entry = &m->entry[index];
+    Firm * f = &e->firm[index];
+    int listed = (entry->stock > 0);
+
+    if (listed) {
+        m->value[entry->product_type][entry->location] -= entry->value;
+        m->stock[entry->product_type][entry->location] -= floorf(entry->stock);
+        if (firm_defunct(f) || (f->process.stock <= 0) ||
+            (entry->product_type != f->process.product_type) ||
+            (entry->location != f->location)) {
+            heap_remove(&m->book[entry->product_type][entry->location],
+                        m->book_position, index);
+            listed = 0;
+        }
+    }
+
+    if (firm_defunct(f) || (f->process.stock <= 0)) {
+        entry->value = 0;
+        entry->stock = 0;
+        return;
+    }
+
+    entry->product_type = f->process.product_type;
+    entry->location = f->location;
+    entry->value = f->sale_value*f->process.stock;
+    entry->stock = f->process.stock;
+    m->value[entry->product_type][entry->location] += entry->value;
+    m->stock[entry->product_type][entry->location] += floorf(entry->stock);
+
+    if (listed) {
+        heap_update(&m->book[entry->product_type][entry->location],
+                    m->book_position, index, f->sale_value);
+    }
+    else {
+        /* books have room for every firm, so this cannot fail */
+        heap_insert(&m->book[entry->product_type][entry->location],
+                    m->book_position, index, f->sale_value);
+    }
+}
+
+/* brings every firm up to date and then recalculates the totals
+   from scratch, which avoids any accumulated rounding errors */
+void market_rebuild(Economy * e)
+{
+    Market * m = &e->market;
+    unsigned int i;
+
+    MarketEntry * entry;
+
+    PROFILE_SCAN(e);
+    for (i = 0; i < m->size; i++) {
+        market_update(e, i);
+    }
+
+    memset(m->value, '\0', sizeof(m->value));
+    memset(m->stock, '\0', sizeof(m->stock));
+    for (i = 0; i < m->size; i++) {
+        entry = &m->entry[i];
+        if (entry->stock <= 0) continue;
+        m->value[entry->product_type][entry->location] += entry->value;
+        m->stock[entry->product_type][entry->location] += floorf(entry->stock);
+    }
+}
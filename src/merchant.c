@@ -32,16 +32,16 @@
 #include "econ.h"
 
 
-void merchant_init(Merchant * m)
+void merchant_init(Merchant * m, Params * p, Rng * rng)
 {
     unsigned int i;
 
-    m->tax_location = (unsigned int)(rand()%LOCATIONS);
+    m->tax_location = rng_range(rng, p->locations);
     m->capital.repayment_per_month = 0;
     m->capital.variable = 0;
     m->capital.constant = 10;
     m->capital.surplus = 0;
-    m->capital.fictitious = INITIAL_MERCHANT_DEPOSIT;
+    m->capital.fictitious = p->initial_merchant_deposit;
     m->interest_rate = 2;
     m->hedge = MAX_PRODUCT_TYPES/2;
     for (i = 0; i < MAX_PRODUCT_TYPES; i++) {
@@ -55,6 +55,7 @@ void merchant_buy(Economy * e)
 {
     unsigned int i;
     Merchant * m = &e->merchant;
+    float max_stock = e->params.max_merchant_stock;
     Firm * f;
     int best_index;
     float investment_tranche = working_capital(&m->capital) / (float)m->hedge;
@@ -63,7 +64,7 @@ void merchant_buy(Economy * e)
 
     /* calculate price variance range for all commodities */
     for (i = 0; i < MAX_PRODUCT_TYPES; i++) {
-        if (m->stock[i] > MAX_MERCHANT_STOCK) continue;
+        if (m->stock[i] > max_stock) continue;
         variance = econ_average_price_variance(e, i);
         if ((variance_max == 0) || (variance > variance_max)) {
             variance_max = variance;
@@ -75,7 +76,7 @@ void merchant_buy(Economy * e)
 
     average_variance = variance_min + ((variance_max - variance_min)/2);
     for (i = 0; i < MAX_PRODUCT_TYPES; i++) {
-        if (m->stock[i] > MAX_MERCHANT_STOCK) continue;
+        if (m->stock[i] > max_stock) continue;
 
         /* prefer high variance trades, where you're
            likely to obtain the most return */
@@ -99,12 +100,13 @@ void merchant_buy(Economy * e)
             if (buy_qty > f->process.stock) {
                 buy_qty = f->process.stock;
             }
-            if (m->stock[i] + buy_qty > MAX_MERCHANT_STOCK) {
-                buy_qty = MAX_MERCHANT_STOCK - m->stock[i];
+            if (m->stock[i] + buy_qty > max_stock) {
+                buy_qty = max_stock - m->stock[i];
             }
             if (buy_qty > 1) {
                 f->process.stock -= buy_qty;
                 if (f->process.stock < 0) f->process.stock = 0;
+                market_update(e, (unsigned int)best_index);
                 m->stock[i] += buy_qty;
                 value = f->sale_value * buy_qty;
                 tax = value * e->state[f->location].VAT_rate / 100.0f;
@@ -118,5 +120,5 @@ void merchant_buy(Economy * e)
 void merchant_update(Economy * e)
 {
     merchant_buy(e);
-    update_history(&e->merchant.capital);
+    update_history(&e->merchant.capital, e->params.history_steps);
 }
@@ -0,0 +1,104 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Runs a function over a range of items using a number of threads.
+   The range is divided into contiguous chunks, one per thread, with
+   the calling thread processing the final chunk itself */
+
+#include <pthread.h>
+#include "econ.h"
+
+typedef struct
+{
+    ParallelFunction fn;
+    void * arg;
+    unsigned int start;
+    unsigned int end;
+} ParallelTask;
+
+static void * parallel_run(void * p)
+{
+    ParallelTask * task = (ParallelTask*)p;
+
+    task->fn(task->arg, task->start, task->end);
+    return NULL;
+}
+
+void parallel_for(unsigned int threads, unsigned int n, ParallelFunction fn, void * arg)
+{
+    unsigned int i, chunk, started = 0;
+    ParallelTask * task;
+    pthread_t * thread;
+
+    if (threads > n / PARALLEL_MIN_CHUNK) threads = n / PARALLEL_MIN_CHUNK;
+    if (threads <= 1) {
+        fn(arg, 0, n);
+        return;
+    }
+
+    task = (ParallelTask*)malloc(threads*sizeof(ParallelTask));
+    thread = (pthread_t*)malloc(threads*sizeof(pthread_t));
+    if ((task == NULL) || (thread == NULL)) {
+        free(task);
+        free(thread);
+        fn(arg, 0, n);
+        return;
+    }
+
+    /* chunks are kept to a multiple of eight items, so that
+       vectorised kernels have whole lanes within each chunk */
+    chunk = ((n / threads) + 7) & ~7u;
+    for (i = 0; i < threads; i++) {
+        task[i].fn = fn;
+        task[i].arg = arg;
+        task[i].start = i*chunk;
+        task[i].end = (i == threads-1) ? n : (i+1)*chunk;
+        if (task[i].end > n) task[i].end = n;
+        if (task[i].start > n) task[i].start = n;
+    }
+
+    for (i = 0; i < threads-1; i++) {
+        if (pthread_create(&thread[i], NULL, parallel_run, &task[i]) != 0) {
+            /* run the remaining chunks on this thread */
+            break;
+        }
+        started++;
+    }
+    for (i = started; i < threads; i++) {
+        parallel_run(&task[i]);
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(thread[i], NULL);
+    }
+
+    free(task);
+    free(thread);
+}
@@ -0,0 +1,168 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Runtime behavioural parameters. Defaults are taken from econ.h, and
+   every parameter can be looked up by name so that values may be
+   supplied on the command line or varied by a parameter sweep */
+
+#include <stddef.h>
+#include "econ.h"
+
+#define PARAM(name, type) { #name, offsetof(Params, name), type }
+
+static const ParamInfo params_table[] = {
+    PARAM(min_working_day, PARAM_FLOAT),
+    PARAM(max_working_day, PARAM_FLOAT),
+    PARAM(min_days_per_week, PARAM_FLOAT),
+    PARAM(max_days_per_week, PARAM_FLOAT),
+    PARAM(min_wage, PARAM_DOUBLE),
+    PARAM(max_wage, PARAM_DOUBLE),
+    PARAM(initial_workers, PARAM_UNSIGNED),
+    PARAM(min_workers, PARAM_UNSIGNED),
+    PARAM(max_workers, PARAM_UNSIGNED),
+    PARAM(min_productivity, PARAM_FLOAT),
+    PARAM(max_productivity, PARAM_FLOAT),
+    PARAM(initial_deposit, PARAM_FLOAT),
+    PARAM(initial_merchant_deposit, PARAM_FLOAT),
+    PARAM(initial_bank_deposit, PARAM_FLOAT),
+    PARAM(initial_state_deposit, PARAM_FLOAT),
+    PARAM(initial_rentier_deposit, PARAM_FLOAT),
+    PARAM(max_merchant_stock, PARAM_FLOAT),
+    PARAM(min_bank_interest, PARAM_FLOAT),
+    PARAM(max_bank_interest, PARAM_FLOAT),
+    PARAM(max_loan_interest, PARAM_FLOAT),
+    PARAM(min_savings_rate, PARAM_FLOAT),
+    PARAM(max_savings_rate, PARAM_FLOAT),
+    PARAM(history_steps, PARAM_UNSIGNED),
+    PARAM(locations, PARAM_UNSIGNED),
+    PARAM(min_vat_rate, PARAM_FLOAT),
+    PARAM(max_vat_rate, PARAM_FLOAT),
+    PARAM(min_business_tax_rate, PARAM_FLOAT),
+    PARAM(max_business_tax_rate, PARAM_FLOAT),
+    PARAM(min_loan, PARAM_FLOAT),
+    PARAM(min_citizens_dividend, PARAM_DOUBLE),
+    PARAM(max_citizens_dividend, PARAM_DOUBLE)
+};
+
+void params_init(Params * p)
+{
+    p->min_working_day = MIN_WORKING_DAY;
+    p->max_working_day = MAX_WORKING_DAY;
+    p->min_days_per_week = MIN_DAYS_PER_WEEK;
+    p->max_days_per_week = MAX_DAYS_PER_WEEK;
+    p->min_wage = MIN_WAGE;
+    p->max_wage = MAX_WAGE;
+    p->initial_workers = INITIAL_WORKERS;
+    p->min_workers = MIN_WORKERS;
+    p->max_workers = MAX_WORKERS;
+    p->min_productivity = MIN_PRODUCTIVITY;
+    p->max_productivity = MAX_PRODUCTIVITY;
+    p->initial_deposit = INITIAL_DEPOSIT;
+    p->initial_merchant_deposit = INITIAL_MERCHANT_DEPOSIT;
+    p->initial_bank_deposit = INITIAL_BANK_DEPOSIT;
+    p->initial_state_deposit = INITIAL_STATE_DEPOSIT;
+    p->initial_rentier_deposit = INITIAL_RENTIER_DEPOSIT;
+    p->max_merchant_stock = MAX_MERCHANT_STOCK;
+    p->min_bank_interest = MIN_BANK_INTEREST;
+    p->max_bank_interest = MAX_BANK_INTEREST;
+    p->max_loan_interest = MAX_LOAN_INTEREST;
+    p->min_savings_rate = MIN_SAVINGS_RATE;
+    p->max_savings_rate = MAX_SAVINGS_RATE;
+    p->history_steps = HISTORY_STEPS;
+    p->locations = LOCATIONS;
+    p->min_vat_rate = MIN_VAT_RATE;
+    p->max_vat_rate = MAX_VAT_RATE;
+    p->min_business_tax_rate = MIN_BUSINESS_TAX_RATE;
+    p->max_business_tax_rate = MAX_BUSINESS_TAX_RATE;
+    p->min_loan = MIN_LOAN;
+    p->min_citizens_dividend = MIN_CITIZENS_DIVIDEND;
+    p->max_citizens_dividend = MAX_CITIZENS_DIVIDEND;
+}
+
+/* returns non-zero if the parameters can be used to create an economy */
+int params_valid(Params * p)
+{
+    if ((p->locations == 0) || (p->locations > MAX_LOCATIONS)) return 0;
+    if (p->history_steps > MAX_HISTORY_STEPS) return 0;
+    if ((p->initial_workers == 0) || (p->max_workers < 2)) return 0;
+    if (p->min_workers > p->max_workers) return 0;
+    if ((p->min_days_per_week < 1) || (p->min_working_day <= 0)) return 0;
+    if (p->min_productivity <= 0) return 0;
+    return 1;
+}
+
+unsigned int params_count(void)
+{
+    return sizeof(params_table)/sizeof(params_table[0]);
+}
+
+const ParamInfo * params_info(unsigned int index)
+{
+    if (index >= params_count()) return NULL;
+    return &params_table[index];
+}
+
+/* returns the description of the named parameter, or NULL */
+const ParamInfo * params_find(const char * name)
+{
+    unsigned int i;
+
+    for (i = 0; i < params_count(); i++) {
+        if (strcmp(params_table[i].name, name) == 0) return &params_table[i];
+    }
+    return NULL;
+}
+
+double params_get(Params * p, const ParamInfo * info)
+{
+    char * field = (char*)p + info->offset;
+
+    if (info->type == PARAM_UNSIGNED) return *(unsigned int*)field;
+    if (info->type == PARAM_DOUBLE) return *(double*)field;
+    return *(float*)field;
+}
+
+/* assigns a value, which is rounded for integer parameters */
+void params_set(Params * p, const ParamInfo * info, double value)
+{
+    char * field = (char*)p + info->offset;
+
+    if (info->type == PARAM_UNSIGNED) {
+        if (value < 0) value = 0;
+        *(unsigned int*)field = (unsigned int)(value + 0.5);
+        return;
+    }
+    if (info->type == PARAM_DOUBLE) {
+        *(double*)field = value;
+        return;
+    }
+    *(float*)field = (float)value;
+}
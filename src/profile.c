@@ -0,0 +1,216 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Per-phase timing and operation counts, which are only compiled in
+   when ECON_PROFILE is defined, as it is by "make profile". On Linux
+   hardware event counts for each phase may also be read, if permitted */
+
+#include "econ.h"
+
+#ifdef ECON_PROFILE
+
+#include <time.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char * profile_counter_name[COUNTERS] = {
+    "best_price", "scans", "firms_visited", "account_probes",
+    "loans_issued", "loans_closed", "mergers", "hires"
+};
+
+static const char * profile_perf_name[PERF_EVENTS] = {
+    "cycles", "instructions", "llc_misses"
+};
+
+/* monotonic time in nanoseconds */
+uint64_t profile_clock(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec*1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+/* reads the hardware event counts into the sample */
+static void profile_perf_read(Profile * p, uint64_t * sample)
+{
+    unsigned int i;
+
+    for (i = 0; i < PERF_EVENTS; i++) {
+        sample[i] = 0;
+#ifdef __linux__
+        if (read(p->perf_fd[i], &sample[i], sizeof(uint64_t)) != sizeof(uint64_t)) {
+            sample[i] = 0;
+        }
+#endif
+    }
+}
+
+/* Opens hardware event counters for the calling thread. Threads created
+   during a phase are also counted, once they have been joined.
+   Returns zero on success */
+int profile_perf_open(Profile * p)
+{
+#ifdef __linux__
+    const uint64_t config[PERF_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+    struct perf_event_attr attr;
+    unsigned int i;
+
+    for (i = 0; i < PERF_EVENTS; i++) {
+        memset(&attr, '\0', sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        p->perf_fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (p->perf_fd[i] < 0) {
+            while (i-- > 0) {
+                close(p->perf_fd[i]);
+            }
+            return -1;
+        }
+    }
+    p->perf = 1;
+    return 0;
+#else
+    (void)p;
+    return -1;
+#endif
+}
+
+void profile_perf_close(Profile * p)
+{
+#ifdef __linux__
+    unsigned int i;
+
+    if (!p->perf) return;
+    for (i = 0; i < PERF_EVENTS; i++) {
+        close(p->perf_fd[i]);
+    }
+#endif
+    p->perf = 0;
+}
+
+/* takes a sample of the clock and any hardware event counts at the
+   start of a phase */
+void profile_begin(Profile * p, uint64_t * sample)
+{
+    if (p->perf) profile_perf_read(p, &sample[1]);
+    sample[0] = profile_clock();
+}
+
+void profile_end(Profile * p, unsigned int phase, uint64_t * sample)
+{
+    uint64_t end[1 + PERF_EVENTS];
+    unsigned int i;
+
+    end[0] = profile_clock();
+    p->last[phase] = end[0] - sample[0];
+    p->total[phase] += end[0] - sample[0];
+    if (p->perf) {
+        profile_perf_read(p, &end[1]);
+        for (i = 0; i < PERF_EVENTS; i++) {
+            p->perf_total[phase][i] += end[1 + i] - sample[1 + i];
+        }
+    }
+}
+
+/* completes the operation counts for a tick */
+void profile_tick(Profile * p)
+{
+    unsigned int i;
+
+    for (i = 0; i < COUNTERS; i++) {
+        p->count_last[i] = p->count[i];
+        p->count_total[i] += p->count[i];
+        p->count[i] = 0;
+    }
+    p->ticks++;
+}
+
+/* writes the cumulative and mean per-tick time spent in each phase,
+   followed by the operation counts and any hardware event counts */
+void profile_report(Profile * p, FILE * fp)
+{
+    unsigned int i, j;
+    uint64_t total = 0;
+    double ticks = (p->ticks > 0) ? p->ticks : 1;
+
+    for (i = 0; i < PHASES; i++) {
+        total += p->total[i];
+    }
+    fprintf(fp, "%-10s %12s %12s %12s %7s\n",
+            "phase", "total ms", "mean us", "last us", "share");
+    for (i = 0; i < PHASES; i++) {
+        fprintf(fp, "%-10s %12.3f %12.3f %12.3f %6.1f%%\n",
+                econ_phase_name(i), p->total[i] / 1e6,
+                p->total[i] / 1e3 / ticks, p->last[i] / 1e3,
+                (total > 0) ? 100.0 * p->total[i] / total : 0.0);
+    }
+    fprintf(fp, "%-10s %12.3f %12.3f\n", "tick", total / 1e6, total / 1e3 / ticks);
+
+    fprintf(fp, "\n%-16s %14s %14s %14s\n", "counter", "total", "mean/tick", "last tick");
+    for (i = 0; i < COUNTERS; i++) {
+        fprintf(fp, "%-16s %14llu %14.1f %14llu\n", profile_counter_name[i],
+                (unsigned long long)p->count_total[i], p->count_total[i] / ticks,
+                (unsigned long long)p->count_last[i]);
+    }
+    if (p->count_total[COUNT_SCANS] > 0) {
+        fprintf(fp, "%-16s %14.1f\n", "firms/scan",
+                (double)p->count_total[COUNT_FIRMS_VISITED] / p->count_total[COUNT_SCANS]);
+    }
+
+    if (!p->perf) return;
+    fprintf(fp, "\n%-10s", "phase");
+    for (j = 0; j < PERF_EVENTS; j++) {
+        fprintf(fp, " %16s", profile_perf_name[j]);
+    }
+    fprintf(fp, " %8s\n", "ipc");
+    for (i = 0; i < PHASES; i++) {
+        fprintf(fp, "%-10s", econ_phase_name(i));
+        for (j = 0; j < PERF_EVENTS; j++) {
+            fprintf(fp, " %16llu", (unsigned long long)p->perf_total[i][j]);
+        }
+        fprintf(fp, " %8.2f\n", (p->perf_total[i][PERF_CYCLES] > 0) ?
+                (double)p->perf_total[i][PERF_INSTRUCTIONS] / p->perf_total[i][PERF_CYCLES] : 0.0);
+    }
+}
+
+#endif
@@ -31,16 +31,16 @@
 
 #include "econ.h"
 
-void rentier_init(Rentier * r)
+void rentier_init(Rentier * r, Params * p, Rng * rng)
 {
-    r->capital.surplus = INITIAL_RENTIER_DEPOSIT;
+    r->capital.surplus = p->initial_rentier_deposit;
     r->capital.variable = 0;
     r->capital.constant = 0;
     r->capital.repayment_per_month = 0;
     r->capital.savings_rate = 0;
     clear_history(&r->capital);
-    r->location = (unsigned int)(rand()%LOCATIONS);
-    r->asset_type = (unsigned int) (rand()%ASSET_TYPES);
+    r->location = rng_range(rng, p->locations);
+    r->asset_type = rng_range(rng, ASSET_TYPES);
     r->quantity = 0;
     r->asset_value = 0;
     r->rent_per_month = 0;
@@ -51,7 +51,7 @@ int rentier_index(Rentier * r, Economy * e)
     unsigned int i;
     Rentier * r2;
 
-    for (i = 0; i < MAX_RENTIERS; i++) {
+    for (i = 0; i < e->rentiers; i++) {
         r2 = &e->rentier[i];
         if (r2 == r) return (int)i;
     }
@@ -64,5 +64,5 @@ void rentier_update(Rentier * r, Economy * e, unsigned int weeks)
     if (r->capital.repayment_per_month == 0) {
     }
 
-    update_history(&r->capital);
+    update_history(&r->capital, e->params.history_steps);
 }
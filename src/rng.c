@@ -0,0 +1,76 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Counter-based random number generation. Each stream is keyed by a
+   seed, an entity type, an entity index and a tick, and each draw is a
+   hash of the key and a counter, in the style of SplitMix64. Any entity's
+   draws can therefore be reproduced independently of every other, which
+   allows entities to be initialised concurrently */
+
+#include "econ.h"
+
+static uint64_t rng_mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void rng_init(Rng * r, uint64_t seed,
+              unsigned int entity_type, unsigned int entity_index,
+              unsigned int tick)
+{
+    uint64_t key = rng_mix(seed + 0x9e3779b97f4a7c15ULL);
+
+    key = rng_mix(key ^ (((uint64_t)entity_type << 32) | tick));
+    key = rng_mix(key ^ entity_index);
+    r->key = key;
+    r->counter = 0;
+}
+
+/* returns the next 32 bit value from the stream */
+unsigned int rng_next(Rng * r)
+{
+    r->counter++;
+    return (unsigned int)(rng_mix(r->key + r->counter*0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+/* returns a value in the range 0 to n-1 */
+unsigned int rng_range(Rng * r, unsigned int n)
+{
+    return (unsigned int)(((uint64_t)rng_next(r) * n) >> 32);
+}
+
+/* returns a value in the range [0,1) */
+float rng_uniform(Rng * r)
+{
+    return (rng_next(r) >> 8) / 16777216.0f;
+}
@@ -0,0 +1,335 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Scenario branching. Many what-if scenarios are run onwards from the
+   same starting economy, typically one loaded from a checkpoint. Each
+   scenario runs within a forked child process, so that the starting
+   state is shared copy-on-write and each branch only costs the memory
+   which it changes. The spec file has one scenario per line, giving a
+   name followed by any number of settings, such as:
+
+       baseline
+       high_vat state.*.VAT_rate=25
+       dividend state.0.citizens_dividend=10 max_loan_interest=20
+
+   where state settings apply to one location or to all of them, and
+   any other name is a runtime parameter. The final aggregates of every
+   scenario are written as CSV, one row per scenario in spec order */
+
+#include <errno.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "econ.h"
+
+#define SCENARIO_NAME_LENGTH 64
+#define SCENARIO_SETTINGS    16
+#define SCENARIO_LINE_LENGTH 1024
+
+typedef struct
+{
+    const char * name;
+    size_t offset;
+} StateField;
+
+static const StateField scenario_state_field[] = {
+    { "VAT_rate", offsetof(State, VAT_rate) },
+    { "business_tax_rate", offsetof(State, business_tax_rate) },
+    { "citizens_dividend", offsetof(State, citizens_dividend) }
+};
+
+typedef struct
+{
+    /* either a runtime parameter or a state field */
+    const ParamInfo * param;
+    const StateField * field;
+    int location;
+    double value;
+} Setting;
+
+typedef struct
+{
+    char name[SCENARIO_NAME_LENGTH];
+    unsigned int settings;
+    Setting setting[SCENARIO_SETTINGS];
+    pid_t pid;
+    int fd;
+    int status;
+    double summary[SUMMARY_FIELDS];
+} Scenario;
+
+/* parses a single name=value setting. Returns zero on success */
+static int scenario_setting(Setting * s, char * text, unsigned int locations)
+{
+    char * value = strchr(text, '='), * field, * end;
+    unsigned int i;
+    long location;
+
+    if (value == NULL) return -1;
+    *value++ = 0;
+    s->value = strtod(value, &end);
+    if ((end == value) || (*end != 0)) return -1;
+    s->param = NULL;
+    s->field = NULL;
+    s->location = -1;
+
+    if (strncmp(text, "state.", 6) != 0) {
+        s->param = params_find(text);
+        return (s->param != NULL) ? 0 : -1;
+    }
+
+    text += 6;
+    field = strchr(text, '.');
+    if (field == NULL) return -1;
+    *field++ = 0;
+    if (strcmp(text, "*") != 0) {
+        location = strtol(text, &end, 10);
+        if ((end == text) || (*end != 0) ||
+            (location < 0) || (location >= (long)locations)) return -1;
+        s->location = (int)location;
+    }
+    for (i = 0; i < sizeof(scenario_state_field)/sizeof(scenario_state_field[0]); i++) {
+        if (strcmp(field, scenario_state_field[i].name) == 0) {
+            s->field = &scenario_state_field[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* reads the spec file. Returns the number of scenarios, or -1 on error */
+static int scenario_load(const char * filename, unsigned int locations, Scenario ** scenarios)
+{
+    FILE * fp;
+    char line[SCENARIO_LINE_LENGTH], * token;
+    unsigned int number = 0, count = 0, max = 0;
+    Scenario * list = NULL, * grown, * sc;
+    int retval = 0;
+
+    fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Unable to open scenarios %s\n", filename);
+        return -1;
+    }
+
+    while ((retval == 0) && (fgets(line, sizeof(line), fp) != NULL)) {
+        number++;
+        token = strtok(line, " \t\r\n");
+        if ((token == NULL) || (token[0] == '#')) continue;
+
+        if (count == max) {
+            max = (max == 0) ? 16 : max*2;
+            grown = (Scenario*)realloc(list, max*sizeof(Scenario));
+            if (grown == NULL) {
+                retval = -1;
+                break;
+            }
+            list = grown;
+        }
+        sc = &list[count++];
+        memset(sc, '\0', sizeof(Scenario));
+        snprintf(sc->name, sizeof(sc->name), "%s", token);
+
+        while ((token = strtok(NULL, " \t\r\n")) != NULL) {
+            if ((sc->settings == SCENARIO_SETTINGS) ||
+                (scenario_setting(&sc->setting[sc->settings], token, locations) != 0)) {
+                fprintf(stderr, "Invalid setting at %s:%u\n", filename, number);
+                retval = -1;
+                break;
+            }
+            sc->settings++;
+        }
+    }
+    fclose(fp);
+
+    if ((retval == 0) && (count == 0)) {
+        fprintf(stderr, "No scenarios within %s\n", filename);
+        retval = -1;
+    }
+    if (retval != 0) {
+        free(list);
+        return -1;
+    }
+    *scenarios = list;
+    return (int)count;
+}
+
+/* applies the settings of a scenario. Returns zero on success */
+static int scenario_apply(Scenario * sc, Economy * e)
+{
+    Params params = e->params;
+    Setting * s;
+    unsigned int i, l;
+
+    for (i = 0; i < sc->settings; i++) {
+        s = &sc->setting[i];
+        if (s->param != NULL) {
+            params_set(&params, s->param, s->value);
+            continue;
+        }
+        for (l = 0; l < e->params.locations; l++) {
+            if ((s->location > -1) && ((unsigned int)s->location != l)) continue;
+            *(float*)((char*)&e->state[l] + s->field->offset) = (float)s->value;
+        }
+    }
+    return econ_set_params(e, &params);
+}
+
+/* runs a scenario within a child process, sending its summary back
+   through the given pipe */
+static void scenario_child(Scenario * sc, Economy * e, unsigned int ticks, int fd)
+{
+    double summary[SUMMARY_FIELDS];
+    unsigned int t;
+
+    if (scenario_apply(sc, e) != 0) {
+        fprintf(stderr, "Invalid parameters for scenario %s\n", sc->name);
+        _exit(2);
+    }
+    for (t = 0; t < ticks; t++) {
+        econ_update(e, 1);
+    }
+    econ_summary(e, summary);
+
+    /* the summary is smaller than the pipe buffer so is written at once */
+    if (write(fd, summary, sizeof(summary)) != (ssize_t)sizeof(summary)) _exit(1);
+    _exit(0);
+}
+
+static int scenario_start(Scenario * list, unsigned int index,
+                          Economy * e, unsigned int ticks)
+{
+    Scenario * sc = &list[index];
+    unsigned int i;
+    int fd[2];
+
+    if (pipe(fd) != 0) return -1;
+    sc->pid = fork();
+    if (sc->pid < 0) {
+        close(fd[0]);
+        close(fd[1]);
+        return -1;
+    }
+    if (sc->pid == 0) {
+        /* the child has no use for the pipes of scenarios which are
+           still running, so they are not left open within it */
+        for (i = 0; i < index; i++) {
+            if (list[i].pid > 0) close(list[i].fd);
+        }
+        close(fd[0]);
+        scenario_child(sc, e, ticks, fd[1]);
+    }
+    close(fd[1]);
+    sc->fd = fd[0];
+    return 0;
+}
+
+/* waits for any running scenario to finish and collects its summary */
+static void scenario_finish(Scenario * list, unsigned int count)
+{
+    unsigned int i;
+    pid_t pid;
+    int status;
+
+    while (1) {
+        pid = wait(&status);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        for (i = 0; i < count; i++) {
+            if (list[i].pid != pid) continue;
+            list[i].status = -1;
+            if ((WIFEXITED(status)) && (WEXITSTATUS(status) == 0) &&
+                (read(list[i].fd, list[i].summary, sizeof(list[i].summary)) ==
+                 (ssize_t)sizeof(list[i].summary))) {
+                list[i].status = 0;
+            }
+            close(list[i].fd);
+            list[i].pid = 0;
+            return;
+        }
+    }
+}
+
+/* Runs each scenario in the given spec file onwards from the given
+   economy for a number of ticks, with up to the given number of
+   branches running at once. The economy itself is left unchanged.
+   Returns the number of scenarios which failed, or -1 on error */
+int scenario_run(Economy * e, const char * filename, unsigned int branches,
+                 unsigned int ticks, FILE * fp)
+{
+    Scenario * list;
+    unsigned int i, j, running = 0, failures = 0;
+    int count;
+
+    count = scenario_load(filename, e->params.locations, &list);
+    if (count < 0) return -1;
+    if (branches == 0) branches = 1;
+
+    /* anything buffered would otherwise be written by every child */
+    fflush(NULL);
+
+    for (i = 0; i < (unsigned int)count; i++) {
+        if (running == branches) {
+            scenario_finish(list, (unsigned int)count);
+            running--;
+        }
+        if (scenario_start(list, i, e, ticks) != 0) {
+            list[i].status = -1;
+            continue;
+        }
+        running++;
+    }
+    while (running > 0) {
+        scenario_finish(list, (unsigned int)count);
+        running--;
+    }
+
+    fprintf(fp, "scenario");
+    econ_summary_header(fp);
+    fprintf(fp, "\n");
+    for (i = 0; i < (unsigned int)count; i++) {
+        fprintf(fp, "%s", list[i].name);
+        for (j = 0; j < SUMMARY_FIELDS; j++) {
+            if (list[i].status == 0) {
+                fprintf(fp, ",%.9g", list[i].summary[j]);
+            }
+            else {
+                fprintf(fp, ",nan");
+            }
+        }
+        fprintf(fp, "\n");
+        if (list[i].status != 0) failures++;
+    }
+    free(list);
+    return (int)failures;
+}
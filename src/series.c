@@ -0,0 +1,398 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Time series output. Selected metrics are recorded after each tick for
+   every location, product type and bank, and written as CSV whose first
+   line names every column. Rows are gathered into one of two buffers
+   while a writer thread formats and writes out the other, so that the
+   simulation only waits if it gets a whole buffer ahead of the disk */
+
+#include <pthread.h>
+#include "econ.h"
+
+#define SERIES_ROWS 256
+
+typedef struct
+{
+    const char * name;
+    unsigned int (*columns)(Economy * e);
+    void (*record)(Economy * e, double * row);
+} SeriesMetric;
+
+static unsigned int series_one(Economy * e)
+{
+    (void)e;
+    return 1;
+}
+
+static unsigned int series_per_location(Economy * e)
+{
+    return e->params.locations;
+}
+
+static unsigned int series_per_product(Economy * e)
+{
+    (void)e;
+    return MAX_PRODUCT_TYPES;
+}
+
+static unsigned int series_per_product_location(Economy * e)
+{
+    return MAX_PRODUCT_TYPES * e->params.locations;
+}
+
+static unsigned int series_per_bank(Economy * e)
+{
+    return e->banks;
+}
+
+static void series_bankruptcies(Economy * e, double * row)
+{
+    row[0] = e->bankruptcies;
+}
+
+static void series_firms(Economy * e, double * row)
+{
+    unsigned int i, live = 0;
+
+    for (i = 0; i < e->size; i++) {
+        if (!firm_defunct(&e->firm[i])) live++;
+    }
+    row[0] = live;
+}
+
+static void series_unemployed(Economy * e, double * row)
+{
+    unsigned int l;
+
+    for (l = 0; l < e->params.locations; l++) {
+        row[l] = e->state[l].unemployed;
+    }
+}
+
+static void series_population(Economy * e, double * row)
+{
+    unsigned int l;
+
+    for (l = 0; l < e->params.locations; l++) {
+        row[l] = e->state[l].population;
+    }
+}
+
+static void series_state_capital(Economy * e, double * row)
+{
+    unsigned int l;
+
+    for (l = 0; l < e->params.locations; l++) {
+        row[l] = working_capital(&e->state[l].capital);
+    }
+}
+
+static void series_price(Economy * e, double * row)
+{
+    unsigned int p, l;
+
+    for (p = 0; p < MAX_PRODUCT_TYPES; p++) {
+        for (l = 0; l < e->params.locations; l++) {
+            row[p*e->params.locations + l] = econ_average_price(e, p, l);
+        }
+    }
+}
+
+static void series_merchant_stock(Economy * e, double * row)
+{
+    unsigned int p;
+
+    for (p = 0; p < MAX_PRODUCT_TYPES; p++) {
+        row[p] = e->merchant.stock[p];
+    }
+}
+
+static void series_merchant_price(Economy * e, double * row)
+{
+    unsigned int p;
+
+    for (p = 0; p < MAX_PRODUCT_TYPES; p++) {
+        row[p] = e->merchant.price[p];
+    }
+}
+
+static void series_bank_worth(Economy * e, double * row)
+{
+    unsigned int i;
+
+    for (i = 0; i < e->banks; i++) {
+        row[i] = bank_worth(&e->bank[i]);
+    }
+}
+
+static void series_bank_accounts(Economy * e, double * row)
+{
+    unsigned int i;
+
+    for (i = 0; i < e->banks; i++) {
+        row[i] = e->bank[i].active_accounts;
+    }
+}
+
+static const SeriesMetric series_metric[] = {
+    { "bankruptcies", series_one, series_bankruptcies },
+    { "firms", series_one, series_firms },
+    { "unemployed", series_per_location, series_unemployed },
+    { "population", series_per_location, series_population },
+    { "state_capital", series_per_location, series_state_capital },
+    { "price", series_per_product_location, series_price },
+    { "merchant_stock", series_per_product, series_merchant_stock },
+    { "merchant_price", series_per_product, series_merchant_price },
+    { "bank_worth", series_per_bank, series_bank_worth },
+    { "bank_accounts", series_per_bank, series_bank_accounts }
+};
+
+#define SERIES_METRICS (sizeof(series_metric)/sizeof(series_metric[0]))
+
+struct series
+{
+    FILE * fp;
+    unsigned int columns;
+    unsigned int metrics;
+    const SeriesMetric * metric[SERIES_METRICS];
+
+    /* rows are added to the filling buffer while the other is written */
+    double * buffer[2];
+    unsigned int rows[2];
+    unsigned int filling;
+    int writing;
+    int closing;
+    int failed;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t written;
+};
+
+/* writes the column names, which are the metric name followed by
+   the location, product type or bank as appropriate */
+static void series_header(Series * s, Economy * e)
+{
+    unsigned int i, j, columns;
+    const SeriesMetric * m;
+
+    fprintf(s->fp, "tick");
+    for (i = 0; i < s->metrics; i++) {
+        m = s->metric[i];
+        columns = m->columns(e);
+        if (m->columns == series_one) {
+            fprintf(s->fp, ",%s", m->name);
+        }
+        else if (m->columns == series_per_product_location) {
+            for (j = 0; j < columns; j++) {
+                fprintf(s->fp, ",%s_%u_%u", m->name,
+                        j / e->params.locations, j % e->params.locations);
+            }
+        }
+        else {
+            for (j = 0; j < columns; j++) {
+                fprintf(s->fp, ",%s_%u", m->name, j);
+            }
+        }
+    }
+    fprintf(s->fp, "\n");
+}
+
+static void * series_writer(void * arg)
+{
+    Series * s = (Series*)arg;
+    unsigned int b, r, c;
+    double * row;
+
+    pthread_mutex_lock(&s->lock);
+    while (1) {
+        while ((s->writing < 0) && (!s->closing)) {
+            pthread_cond_wait(&s->ready, &s->lock);
+        }
+        if (s->writing < 0) break;
+        b = (unsigned int)s->writing;
+        pthread_mutex_unlock(&s->lock);
+
+        for (r = 0; r < s->rows[b]; r++) {
+            row = &s->buffer[b][r*s->columns];
+            fprintf(s->fp, "%.0f", row[0]);
+            for (c = 1; c < s->columns; c++) {
+                fprintf(s->fp, ",%.9g", row[c]);
+            }
+            fprintf(s->fp, "\n");
+        }
+        if (ferror(s->fp)) s->failed = 1;
+
+        pthread_mutex_lock(&s->lock);
+        s->rows[b] = 0;
+        s->writing = -1;
+        pthread_cond_signal(&s->written);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+/* hands the filling buffer to the writer, once it has finished with the other */
+static void series_swap(Series * s)
+{
+    pthread_mutex_lock(&s->lock);
+    while (s->writing >= 0) {
+        pthread_cond_wait(&s->written, &s->lock);
+    }
+    s->writing = (int)s->filling;
+    s->filling = 1 - s->filling;
+    pthread_cond_signal(&s->ready);
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* returns the metric of the given name and length, or NULL */
+static const SeriesMetric * series_find(const char * name, size_t length)
+{
+    unsigned int i;
+
+    for (i = 0; i < SERIES_METRICS; i++) {
+        if ((strlen(series_metric[i].name) == length) &&
+            (strncmp(series_metric[i].name, name, length) == 0)) {
+            return &series_metric[i];
+        }
+    }
+    return NULL;
+}
+
+static void series_free(Series * s)
+{
+    if (s->fp != NULL) fclose(s->fp);
+    free(s->buffer[0]);
+    free(s->buffer[1]);
+    free(s);
+}
+
+/* Opens a time series file for the given economy. Metrics is a comma
+   separated list of metric names, or NULL for all of them.
+   Returns NULL on failure */
+Series * series_open(Economy * e, const char * filename, const char * metrics)
+{
+    Series * s;
+    unsigned int i;
+    const char * name, * end;
+    const SeriesMetric * m;
+
+    s = (Series*)calloc(1, sizeof(Series));
+    if (s == NULL) return NULL;
+
+    if (metrics == NULL) {
+        for (i = 0; i < SERIES_METRICS; i++) {
+            s->metric[s->metrics++] = &series_metric[i];
+        }
+    }
+    else {
+        for (name = metrics; *name != 0; name = (*end == ',') ? end + 1 : end) {
+            end = strchr(name, ',');
+            if (end == NULL) end = name + strlen(name);
+            m = series_find(name, (size_t)(end - name));
+            if ((m == NULL) || (s->metrics == SERIES_METRICS)) {
+                fprintf(stderr, "Unknown metric %.*s\n", (int)(end - name), name);
+                series_free(s);
+                return NULL;
+            }
+            s->metric[s->metrics++] = m;
+        }
+    }
+    s->columns = 1;
+    for (i = 0; i < s->metrics; i++) {
+        s->columns += s->metric[i]->columns(e);
+    }
+
+    s->buffer[0] = (double*)malloc(SERIES_ROWS*s->columns*sizeof(double));
+    s->buffer[1] = (double*)malloc(SERIES_ROWS*s->columns*sizeof(double));
+    s->fp = fopen(filename, "w");
+    if ((s->metrics == 0) || (s->buffer[0] == NULL) ||
+        (s->buffer[1] == NULL) || (s->fp == NULL)) {
+        series_free(s);
+        return NULL;
+    }
+    series_header(s, e);
+
+    s->writing = -1;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->ready, NULL);
+    pthread_cond_init(&s->written, NULL);
+    if (pthread_create(&s->thread, NULL, series_writer, s) != 0) {
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->ready);
+        pthread_cond_destroy(&s->written);
+        series_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+/* records the selected metrics for the current tick */
+void series_record(Series * s, Economy * e)
+{
+    unsigned int i, c = 1;
+    double * row = &s->buffer[s->filling][s->rows[s->filling]*s->columns];
+
+    row[0] = e->tick;
+    for (i = 0; i < s->metrics; i++) {
+        s->metric[i]->record(e, &row[c]);
+        c += s->metric[i]->columns(e);
+    }
+    if (++s->rows[s->filling] == SERIES_ROWS) {
+        series_swap(s);
+    }
+}
+
+/* writes any remaining rows and closes the file.
+   Returns zero if everything was written */
+int series_close(Series * s)
+{
+    int retval;
+
+    if (s->rows[s->filling] > 0) {
+        series_swap(s);
+    }
+    pthread_mutex_lock(&s->lock);
+    s->closing = 1;
+    pthread_cond_signal(&s->ready);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->thread, NULL);
+
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->ready);
+    pthread_cond_destroy(&s->written);
+    retval = s->failed;
+    if (fclose(s->fp) != 0) retval = -1;
+    s->fp = NULL;
+    series_free(s);
+    return retval;
+}
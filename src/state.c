@@ -31,23 +31,23 @@
 
 #include "econ.h"
 
-void state_init(State * s)
+void state_init(State * s, Params * p, Rng * rng)
 {
-    s->capital.fictitious = INITIAL_STATE_DEPOSIT;
+    s->capital.fictitious = p->initial_state_deposit;
     s->capital.surplus = 0;
     s->capital.variable = 0;
     s->capital.constant = 0;
     s->capital.repayment_per_month = 0;
     s->capital.savings_rate = 0;
     clear_history(&s->capital);
-    s->population = INITIAL_WORKERS;
+    s->population = p->initial_workers;
     s->unemployed = 0;
-    s->VAT_rate = MIN_VAT_RATE +
-        ((rand()%10000/10000.0)*(MAX_VAT_RATE - MIN_VAT_RATE));
-    s->business_tax_rate = MIN_BUSINESS_TAX_RATE +
-        ((rand()%10000/10000.0f)*(MAX_BUSINESS_TAX_RATE - MIN_BUSINESS_TAX_RATE));
-    s->citizens_dividend = MIN_CITIZENS_DIVIDEND +
-        ((rand()%10000/10000.0f)*(MAX_CITIZENS_DIVIDEND - MIN_CITIZENS_DIVIDEND));
+    s->VAT_rate = p->min_vat_rate +
+        (rng_uniform(rng)*(p->max_vat_rate - p->min_vat_rate));
+    s->business_tax_rate = p->min_business_tax_rate +
+        (rng_uniform(rng)*(p->max_business_tax_rate - p->min_business_tax_rate));
+    s->citizens_dividend = p->min_citizens_dividend +
+        (rng_uniform(rng)*(p->max_citizens_dividend - p->min_citizens_dividend));
 }
 
 float state_spending(State * s, unsigned int weeks)
@@ -63,7 +63,7 @@ int state_index(State * s, Economy * e)
     unsigned int i;
     State * s2;
 
-    for (i = 0; i < LOCATIONS; i++) {
+    for (i = 0; i < e->params.locations; i++) {
         s2 = &e->state[i];
         if (s2 == s) return (int)i;
     }
@@ -93,5 +93,5 @@ void state_update(State * s, Economy * e, unsigned int weeks)
 
     /* spending */
     subtract_capital(&s->capital, state_spending(s, weeks));
-    update_history(&s->capital);
+    update_history(&s->capital, e->params.history_steps);
 }
@@ -0,0 +1,171 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Streaming statistics. Means and variances are accumulated using
+   Welford's method, and quantiles are estimated with the P-squared
+   algorithm of Jain and Chlamtac, so that neither needs to keep the
+   observations themselves */
+
+#include "econ.h"
+
+void moments_init(Moments * m)
+{
+    m->count = 0;
+    m->mean = 0;
+    m->m2 = 0;
+}
+
+void moments_add(Moments * m, double x)
+{
+    double delta = x - m->mean;
+
+    m->count++;
+    m->mean += delta / m->count;
+    m->m2 += delta * (x - m->mean);
+}
+
+double moments_stddev(Moments * m)
+{
+    if (m->count < 2) return 0;
+    return sqrt(m->m2 / (m->count - 1));
+}
+
+void quantile_init(Quantile * q, double p)
+{
+    q->p = p;
+    q->count = 0;
+    q->dn[0] = 0;
+    q->dn[1] = p/2;
+    q->dn[2] = p;
+    q->dn[3] = (1+p)/2;
+    q->dn[4] = 1;
+}
+
+static double quantile_parabolic(Quantile * q, int i, double d)
+{
+    return q->q[i] + d / (q->n[i+1] - q->n[i-1]) *
+        ((q->n[i] - q->n[i-1] + d) * (q->q[i+1] - q->q[i]) / (q->n[i+1] - q->n[i]) +
+         (q->n[i+1] - q->n[i] - d) * (q->q[i] - q->q[i-1]) / (q->n[i] - q->n[i-1]));
+}
+
+static double quantile_linear(Quantile * q, int i, int d)
+{
+    return q->q[i] + d * (q->q[i+d] - q->q[i]) / (q->n[i+d] - q->n[i]);
+}
+
+void quantile_add(Quantile * q, double x)
+{
+    int i, j, k;
+    double d, v;
+
+    /* the first five observations become the initial markers */
+    if (q->count < 5) {
+        q->q[q->count++] = x;
+        if (q->count == 5) {
+            for (i = 1; i < 5; i++) {
+                v = q->q[i];
+                for (j = i - 1; (j >= 0) && (q->q[j] > v); j--) {
+                    q->q[j+1] = q->q[j];
+                }
+                q->q[j+1] = v;
+            }
+            for (i = 0; i < 5; i++) {
+                q->n[i] = i;
+            }
+            q->np[0] = 0;
+            q->np[1] = 2*q->p;
+            q->np[2] = 4*q->p;
+            q->np[3] = 2 + 2*q->p;
+            q->np[4] = 4;
+        }
+        return;
+    }
+    q->count++;
+
+    /* find the cell containing the observation */
+    if (x < q->q[0]) {
+        q->q[0] = x;
+        k = 0;
+    }
+    else if (x >= q->q[4]) {
+        q->q[4] = x;
+        k = 3;
+    }
+    else {
+        for (k = 0; k < 3; k++) {
+            if (x < q->q[k+1]) break;
+        }
+    }
+    for (i = k + 1; i < 5; i++) {
+        q->n[i]++;
+    }
+    for (i = 0; i < 5; i++) {
+        q->np[i] += q->dn[i];
+    }
+
+    /* adjust the heights of the middle markers */
+    for (i = 1; i < 4; i++) {
+        d = q->np[i] - q->n[i];
+        if (((d >= 1) && (q->n[i+1] - q->n[i] > 1)) ||
+            ((d <= -1) && (q->n[i-1] - q->n[i] < -1))) {
+            d = (d > 0) ? 1 : -1;
+            v = quantile_parabolic(q, i, d);
+            if ((q->q[i-1] < v) && (v < q->q[i+1])) {
+                q->q[i] = v;
+            }
+            else {
+                q->q[i] = quantile_linear(q, i, (int)d);
+            }
+            q->n[i] += d;
+        }
+    }
+}
+
+double quantile_value(Quantile * q)
+{
+    double sorted[5], v;
+    int i, j;
+
+    if (q->count == 0) return 0;
+    if (q->count >= 5) return q->q[2];
+
+    /* too few observations for the markers, so use the nearest rank */
+    for (i = 0; i < (int)q->count; i++) {
+        v = q->q[i];
+        for (j = i - 1; (j >= 0) && (sorted[j] > v); j--) {
+            sorted[j+1] = sorted[j];
+        }
+        sorted[j+1] = v;
+    }
+    i = (int)(q->p * q->count);
+    if (i >= (int)q->count) i = (int)q->count - 1;
+    return sorted[i];
+}
@@ -0,0 +1,305 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Structure of arrays copy of the firm data used by the economics
+   kernels. Each quantity is held in its own contiguous array so that
+   whole populations of firms can be processed in a single pass, with
+   the compiler able to use SIMD lanes. The array of Firm structures
+   remains the authoritative copy, and values are gathered into the
+   store before a batch pass and scattered back afterwards */
+
+#include "econ.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STORE_X86
+#endif
+
+int firm_store_init(FirmStore * s, unsigned int size, Params * p)
+{
+    unsigned int i;
+    float ** arrays[] = {
+        &s->workers, &s->days_per_week, &s->wage_rate, &s->productivity,
+        &s->time_total, &s->constant, &s->repayment_per_month,
+        &s->sale_value, &s->stock, &s->surplus,
+        &s->products_per_day, &s->wages_per_day, &s->fixed_per_day,
+        &s->surplus_per_day
+    };
+
+    s->size = size;
+    s->initial_workers = (float)p->initial_workers;
+    for (i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++) {
+        *arrays[i] = (float*)malloc(size*sizeof(float));
+        if (*arrays[i] == NULL) return -1;
+    }
+    for (i = 0; i < PROCESS_INPUTS; i++) {
+        s->raw_material_stock[i] = (float*)malloc(size*sizeof(float));
+        if (s->raw_material_stock[i] == NULL) return -1;
+    }
+    return 0;
+}
+
+void firm_store_free(FirmStore * s)
+{
+    unsigned int i;
+
+    free(s->workers);
+    free(s->days_per_week);
+    free(s->wage_rate);
+    free(s->productivity);
+    free(s->time_total);
+    free(s->constant);
+    free(s->repayment_per_month);
+    free(s->sale_value);
+    free(s->stock);
+    free(s->surplus);
+    for (i = 0; i < PROCESS_INPUTS; i++) {
+        free(s->raw_material_stock[i]);
+    }
+    free(s->products_per_day);
+    free(s->wages_per_day);
+    free(s->fixed_per_day);
+    free(s->surplus_per_day);
+    memset(s, '\0', sizeof(FirmStore));
+}
+
+/* copies firms within the range [start, end) into the store */
+void firm_store_load(FirmStore * s, Economy * e, unsigned int start, unsigned int end)
+{
+    unsigned int i, j;
+    Firm * f;
+
+    for (i = start; i < end; i++) {
+        f = &e->firm[i];
+        s->workers[i] = (float)f->labour.workers;
+        s->days_per_week[i] = (float)f->labour.days_per_week;
+        s->wage_rate[i] = f->labour.wage_rate;
+        s->productivity[i] = f->labour.productivity;
+        s->time_total[i] = f->labour.time_total;
+        s->constant[i] = f->capital.constant;
+        s->repayment_per_month[i] = f->capital.repayment_per_month;
+        s->sale_value[i] = f->sale_value;
+        s->stock[i] = f->process.stock;
+        s->surplus[i] = f->capital.surplus;
+        for (j = 0; j < PROCESS_INPUTS; j++) {
+            s->raw_material_stock[j][i] = f->process.raw_material_stock[j];
+        }
+    }
+}
+
+/* copies the quantities which batch kernels may alter back into the
+   firms within the range [start, end) */
+void firm_store_save(FirmStore * s, Economy * e, unsigned int start, unsigned int end)
+{
+    unsigned int i, j;
+    Firm * f;
+
+    for (i = start; i < end; i++) {
+        f = &e->firm[i];
+        if (f->labour.workers == 0) continue;
+        f->process.stock = s->stock[i];
+        f->capital.surplus = s->surplus[i];
+        for (j = 0; j < PROCESS_INPUTS; j++) {
+            f->process.raw_material_stock[j] = s->raw_material_stock[j][i];
+        }
+    }
+}
+
+/* Calculates the daily output, wages, fixed costs and surplus of firms
+   within the range [start, end). The arithmetic is carried out in the
+   same order as firm_products_made_per_day, firm_variable_labour_per_day,
+   firm_constant_per_day and firm_surplus_per_day, so that the results
+   are identical to those of the per-firm functions */
+void firm_store_daily(FirmStore * s, unsigned int start, unsigned int end)
+{
+    unsigned int i;
+    const float * restrict workers = s->workers;
+    const float * restrict wage_rate = s->wage_rate;
+    const float * restrict productivity = s->productivity;
+    const float * restrict time_total = s->time_total;
+    const float * restrict constant = s->constant;
+    const float * restrict repayment = s->repayment_per_month;
+    const float * restrict sale_value = s->sale_value;
+    float * restrict products = s->products_per_day;
+    float * restrict wages = s->wages_per_day;
+    float * restrict fixed = s->fixed_per_day;
+    float * restrict surplus = s->surplus_per_day;
+
+    for (i = start; i < end; i++) {
+        products[i] =
+            productivity[i] * s->initial_workers / (1 + workers[i]) *
+            time_total[i] * workers[i];
+    }
+    for (i = start; i < end; i++) {
+        wages[i] = wage_rate[i] * time_total[i] * workers[i];
+        fixed[i] = constant[i] * workers[i];
+    }
+    for (i = start; i < end; i++) {
+        surplus[i] = sale_value[i] * products[i] -
+            (wages[i] + fixed[i] + repayment[i]/30.0f);
+    }
+}
+
+/* Production accounting for a single firm, as in firm_production */
+static void firm_store_production_firm(FirmStore * s, float weeks, unsigned int i)
+{
+    unsigned int j;
+    float days, new_products, products_per_day, income, costs, made;
+
+    if (s->workers[i] == 0) return;
+
+    days = s->days_per_week[i] * weeks;
+    new_products = 0;
+    for (j = 0; j < PROCESS_INPUTS; j++) {
+        if ((new_products == 0) || (s->raw_material_stock[j][i] < new_products)) {
+            new_products = s->raw_material_stock[j][i];
+        }
+    }
+    products_per_day =
+        s->productivity[i] * s->initial_workers / (1 + s->workers[i]) *
+        s->time_total[i] * s->workers[i];
+    if (products_per_day*days < new_products/products_per_day) {
+        days = (float)(unsigned int)(new_products / products_per_day);
+    }
+
+    if (new_products > products_per_day) {
+        income = s->sale_value[i] * products_per_day;
+    }
+    else {
+        income = s->sale_value[i] * new_products;
+    }
+    costs =
+        s->wage_rate[i] * s->time_total[i] * s->workers[i] +
+        s->constant[i] * s->workers[i] + s->repayment_per_month[i]/30.0f;
+    made = products_per_day * days;
+
+    s->surplus[i] += (income - costs) * days;
+    s->stock[i] += made;
+    for (j = 0; j < PROCESS_INPUTS; j++) {
+        s->raw_material_stock[j][i] -= made;
+        if (s->raw_material_stock[j][i] < 0) {
+            s->raw_material_stock[j][i] = 0;
+        }
+    }
+}
+
+#ifdef STORE_X86
+/* Production accounting for eight firms at a time. Lanes belonging to
+   defunct firms are masked out, and every operation matches the scalar
+   version so that the results are identical. Fused multiply-add is not
+   enabled, since it would change the rounding */
+__attribute__((target("avx2")))
+static unsigned int firm_store_production_avx2(FirmStore * s, float weeks,
+                                               unsigned int start, unsigned int end)
+{
+    unsigned int i, j;
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 initial_workers = _mm256_set1_ps(s->initial_workers);
+    const __m256 month = _mm256_set1_ps(30.0f);
+    const __m256 weeks8 = _mm256_set1_ps(weeks);
+    __m256 workers, live, days, new_products, stock, products_per_day;
+    __m256 longer, income, costs, made;
+
+    for (i = start; i + 8 <= end; i += 8) {
+        workers = _mm256_loadu_ps(&s->workers[i]);
+        live = _mm256_cmp_ps(workers, zero, _CMP_NEQ_UQ);
+        if (_mm256_movemask_ps(live) == 0) continue;
+
+        days = _mm256_mul_ps(_mm256_loadu_ps(&s->days_per_week[i]), weeks8);
+        new_products = zero;
+        for (j = 0; j < PROCESS_INPUTS; j++) {
+            stock = _mm256_loadu_ps(&s->raw_material_stock[j][i]);
+            new_products =
+                _mm256_blendv_ps(new_products, stock,
+                                 _mm256_or_ps(_mm256_cmp_ps(new_products, zero, _CMP_EQ_OQ),
+                                              _mm256_cmp_ps(stock, new_products, _CMP_LT_OQ)));
+        }
+
+        products_per_day =
+            _mm256_mul_ps(_mm256_mul_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_loadu_ps(&s->productivity[i]),
+                                                                    initial_workers),
+                                                      _mm256_add_ps(one, workers)),
+                                        _mm256_loadu_ps(&s->time_total[i])),
+                          workers);
+        longer = _mm256_div_ps(new_products, products_per_day);
+        days = _mm256_blendv_ps(days, _mm256_round_ps(longer, _MM_FROUND_TO_ZERO|_MM_FROUND_NO_EXC),
+                                _mm256_cmp_ps(_mm256_mul_ps(products_per_day, days), longer, _CMP_LT_OQ));
+
+        income = _mm256_mul_ps(_mm256_loadu_ps(&s->sale_value[i]),
+                               _mm256_blendv_ps(new_products, products_per_day,
+                                                _mm256_cmp_ps(new_products, products_per_day, _CMP_GT_OQ)));
+        costs =
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(&s->wage_rate[i]),
+                                                                    _mm256_loadu_ps(&s->time_total[i])),
+                                                      workers),
+                                        _mm256_mul_ps(_mm256_loadu_ps(&s->constant[i]), workers)),
+                          _mm256_div_ps(_mm256_loadu_ps(&s->repayment_per_month[i]), month));
+        made = _mm256_mul_ps(products_per_day, days);
+
+        stock = _mm256_loadu_ps(&s->surplus[i]);
+        _mm256_storeu_ps(&s->surplus[i],
+                         _mm256_blendv_ps(stock,
+                                          _mm256_add_ps(stock, _mm256_mul_ps(_mm256_sub_ps(income, costs), days)),
+                                          live));
+        stock = _mm256_loadu_ps(&s->stock[i]);
+        _mm256_storeu_ps(&s->stock[i],
+                         _mm256_blendv_ps(stock, _mm256_add_ps(stock, made), live));
+        for (j = 0; j < PROCESS_INPUTS; j++) {
+            stock = _mm256_loadu_ps(&s->raw_material_stock[j][i]);
+            new_products = _mm256_sub_ps(stock, made);
+            new_products = _mm256_blendv_ps(new_products, zero,
+                                            _mm256_cmp_ps(new_products, zero, _CMP_LT_OQ));
+            _mm256_storeu_ps(&s->raw_material_stock[j][i],
+                             _mm256_blendv_ps(stock, new_products, live));
+        }
+    }
+    return i;
+}
+#endif
+
+/* Production accounting for firms within the range [start, end).
+   When simd is non-zero and the processor supports AVX2 then eight
+   firms are processed at a time */
+void firm_store_production(FirmStore * s, unsigned int weeks,
+                           unsigned int start, unsigned int end, int simd)
+{
+    unsigned int i = start;
+
+#ifdef STORE_X86
+    if ((simd != 0) && __builtin_cpu_supports("avx2")) {
+        i = firm_store_production_avx2(s, (float)weeks, start, end);
+    }
+#endif
+    for (; i < end; i++) {
+        firm_store_production_firm(s, (float)weeks, i);
+    }
+}
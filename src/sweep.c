@@ -0,0 +1,337 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Parameter sweeps. A spec file lists the parameters to be varied,
+   one per line as "name min max [steps]", together with optional
+   "mode grid", "mode lhs N" and "ticks N" lines. In grid mode every
+   combination of the stepped values is run, and in Latin hypercube mode
+   N points are sampled such that each parameter's range is divided into
+   N strata with one point in each. Points are shared out across a pool
+   of threads and one CSV row of final aggregates is written per point */
+
+#include <pthread.h>
+#include "econ.h"
+
+#define SWEEP_MAX_DIMENSIONS 32
+#define SWEEP_MAX_POINTS     1000000
+#define SWEEP_LINE_LENGTH    256
+
+enum {
+    SWEEP_GRID,
+    SWEEP_LHS
+};
+
+typedef struct
+{
+    const ParamInfo * param;
+    double min, max;
+    unsigned int steps;
+} SweepDimension;
+
+typedef struct
+{
+    EconomyConfig * config;
+    unsigned int mode;
+    unsigned int ticks;
+    unsigned int dimensions;
+    SweepDimension dimension[SWEEP_MAX_DIMENSIONS];
+    unsigned int points;
+    unsigned int next_point;
+    unsigned int failures;
+    double * values;
+    double * results;
+    pthread_mutex_t lock;
+} Sweep;
+
+/* reads the spec file. Returns zero on success */
+static int sweep_load(Sweep * sw, const char * filename)
+{
+    FILE * fp;
+    char line[SWEEP_LINE_LENGTH], name[SWEEP_LINE_LENGTH], mode[16];
+    unsigned int number = 0, steps;
+    double min, max;
+    int fields, retval = 0;
+    SweepDimension * d;
+
+    fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Unable to open sweep spec %s\n", filename);
+        return -1;
+    }
+
+    while ((retval == 0) && (fgets(line, sizeof(line), fp) != NULL)) {
+        number++;
+        if ((sscanf(line, "%255s", name) != 1) || (name[0] == '#')) continue;
+
+        if (strcmp(name, "mode") == 0) {
+            fields = sscanf(line, "%*s %15s %u", mode, &sw->points);
+            if ((fields >= 1) && (strcmp(mode, "grid") == 0)) {
+                sw->mode = SWEEP_GRID;
+            }
+            else if ((fields == 2) && (strcmp(mode, "lhs") == 0) &&
+                     (sw->points > 0) && (sw->points <= SWEEP_MAX_POINTS)) {
+                sw->mode = SWEEP_LHS;
+            }
+            else {
+                retval = -1;
+            }
+        }
+        else if (strcmp(name, "ticks") == 0) {
+            if (sscanf(line, "%*s %u", &sw->ticks) != 1) retval = -1;
+        }
+        else {
+            steps = 0;
+            fields = sscanf(line, "%255s %lf %lf %u", name, &min, &max, &steps);
+            if ((fields < 3) || (sw->dimensions >= SWEEP_MAX_DIMENSIONS)) {
+                retval = -1;
+            }
+            else if (params_find(name) == NULL) {
+                fprintf(stderr, "Unknown parameter %s\n", name);
+                retval = -1;
+            }
+            else {
+                d = &sw->dimension[sw->dimensions++];
+                d->param = params_find(name);
+                d->min = min;
+                d->max = max;
+                if (steps == 0) steps = (max > min) ? 2 : 1;
+                d->steps = steps;
+            }
+        }
+        if (retval != 0) {
+            fprintf(stderr, "Invalid sweep spec at %s:%u\n", filename, number);
+        }
+    }
+    fclose(fp);
+    if ((retval == 0) && (sw->dimensions == 0)) {
+        fprintf(stderr, "No parameters to sweep in %s\n", filename);
+        retval = -1;
+    }
+    return retval;
+}
+
+static int sweep_grid(Sweep * sw)
+{
+    unsigned int i, j, index, points = 1;
+    SweepDimension * d;
+
+    for (j = 0; j < sw->dimensions; j++) {
+        points *= sw->dimension[j].steps;
+        if (points > SWEEP_MAX_POINTS) return -1;
+    }
+    sw->points = points;
+    sw->values = (double*)malloc(points*sw->dimensions*sizeof(double));
+    if (sw->values == NULL) return -1;
+
+    /* the last parameter varies fastest */
+    for (i = 0; i < points; i++) {
+        index = i;
+        for (j = sw->dimensions; j-- > 0;) {
+            d = &sw->dimension[j];
+            sw->values[i*sw->dimensions + j] = d->min;
+            if (d->steps > 1) {
+                sw->values[i*sw->dimensions + j] +=
+                    (d->max - d->min) * (index % d->steps) / (d->steps - 1);
+            }
+            index /= d->steps;
+        }
+    }
+    return 0;
+}
+
+/* Latin hypercube sample, with each parameter's strata visited in an
+   order given by a shuffle drawn from the configured seed */
+static int sweep_lhs(Sweep * sw)
+{
+    unsigned int i, j, k, swap, * order;
+    SweepDimension * d;
+    Rng rng;
+
+    sw->values = (double*)malloc(sw->points*sw->dimensions*sizeof(double));
+    order = (unsigned int*)malloc(sw->points*sizeof(unsigned int));
+    if ((sw->values == NULL) || (order == NULL)) {
+        free(order);
+        return -1;
+    }
+
+    for (j = 0; j < sw->dimensions; j++) {
+        d = &sw->dimension[j];
+        rng_init(&rng, sw->config->seed, ENTITY_NONE, j, 0);
+        for (i = 0; i < sw->points; i++) {
+            order[i] = i;
+        }
+        for (i = sw->points; i > 1; i--) {
+            k = rng_range(&rng, i);
+            swap = order[i-1];
+            order[i-1] = order[k];
+            order[k] = swap;
+        }
+        for (i = 0; i < sw->points; i++) {
+            sw->values[i*sw->dimensions + j] = d->min +
+                (d->max - d->min) * (order[i] + rng_uniform(&rng)) / sw->points;
+        }
+    }
+    free(order);
+    return 0;
+}
+
+static void * sweep_worker(void * arg)
+{
+    Sweep * sw = (Sweep*)arg;
+    EconomyConfig config;
+    unsigned int point, j, t;
+    double * result;
+    Economy * e;
+
+    while (1) {
+        pthread_mutex_lock(&sw->lock);
+        point = sw->next_point++;
+        pthread_mutex_unlock(&sw->lock);
+        if (point >= sw->points) break;
+
+        /* every point shares the same seed, so that differences
+           between points are due to the parameters alone */
+        config = *sw->config;
+        config.threads = 1;
+        for (j = 0; j < sw->dimensions; j++) {
+            params_set(&config.params, sw->dimension[j].param,
+                       sw->values[point*sw->dimensions + j]);
+        }
+
+        result = &sw->results[point*SUMMARY_FIELDS];
+        e = econ_create(&config);
+        if (e == NULL) {
+            for (j = 0; j < SUMMARY_FIELDS; j++) {
+                result[j] = NAN;
+            }
+            pthread_mutex_lock(&sw->lock);
+            sw->failures++;
+            pthread_mutex_unlock(&sw->lock);
+            continue;
+        }
+        for (t = 0; t < sw->ticks; t++) {
+            econ_update(e, 1);
+        }
+        econ_summary(e, result);
+        econ_destroy(e);
+    }
+    return NULL;
+}
+
+static void sweep_write(Sweep * sw, FILE * fp)
+{
+    unsigned int i, j;
+    Params params;
+
+    fprintf(fp, "point");
+    for (j = 0; j < sw->dimensions; j++) {
+        fprintf(fp, ",%s", sw->dimension[j].param->name);
+    }
+    econ_summary_header(fp);
+    fprintf(fp, "\n");
+
+    for (i = 0; i < sw->points; i++) {
+        fprintf(fp, "%u", i);
+
+        /* values as actually used, after any rounding */
+        params = sw->config->params;
+        for (j = 0; j < sw->dimensions; j++) {
+            params_set(&params, sw->dimension[j].param, sw->values[i*sw->dimensions + j]);
+            fprintf(fp, ",%.9g", params_get(&params, sw->dimension[j].param));
+        }
+        for (j = 0; j < SUMMARY_FIELDS; j++) {
+            fprintf(fp, ",%.9g", sw->results[i*SUMMARY_FIELDS + j]);
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+/* Runs the parameter sweep described in the given spec file, using the
+   config for any parameters which are not swept. A ticks line within the
+   spec overrides the given number of ticks. Returns the number of points
+   which could not be run, or -1 on error */
+int sweep_run(EconomyConfig * config, const char * filename, unsigned int threads,
+              unsigned int ticks, FILE * fp)
+{
+    Sweep sw;
+    pthread_t * thread;
+    unsigned int i, started = 0;
+    int retval;
+
+    memset(&sw, '\0', sizeof(sw));
+    sw.config = config;
+    sw.mode = SWEEP_GRID;
+    sw.ticks = ticks;
+    if (sweep_load(&sw, filename) != 0) return -1;
+
+    if (sw.mode == SWEEP_LHS) {
+        retval = sweep_lhs(&sw);
+    }
+    else {
+        retval = sweep_grid(&sw);
+    }
+    if (retval != 0) {
+        fprintf(stderr, "Unable to generate the sweep points\n");
+        free(sw.values);
+        return -1;
+    }
+
+    if (threads == 0) threads = 1;
+    if (threads > sw.points) threads = sw.points;
+    sw.results = (double*)malloc(sw.points*SUMMARY_FIELDS*sizeof(double));
+    thread = (pthread_t*)malloc(threads*sizeof(pthread_t));
+    if ((sw.results == NULL) || (thread == NULL)) {
+        free(sw.values);
+        free(sw.results);
+        free(thread);
+        return -1;
+    }
+    pthread_mutex_init(&sw.lock, NULL);
+
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&thread[i], NULL, sweep_worker, &sw) != 0) break;
+        started++;
+    }
+    if (started == 0) {
+        sweep_worker(&sw);
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(thread[i], NULL);
+    }
+    pthread_mutex_destroy(&sw.lock);
+
+    sweep_write(&sw, fp);
+
+    free(sw.values);
+    free(sw.results);
+    free(thread);
+    return (int)sw.failures;
+}
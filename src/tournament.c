@@ -0,0 +1,111 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Tournament tree over a fixed set of items, each having a float key.
+   Every internal node holds the winner of its two children, being the
+   item with the greatest key, or the lowest numbered item when keys are
+   equal. Items which should not take part have a key of -INFINITY */
+
+#include "econ.h"
+
+static int tournament_winner(Tournament * t, int a, int b)
+{
+    if (a == -1) return b;
+    if (b == -1) return a;
+    if (t->key[b] > t->key[a]) return b;
+    if ((t->key[b] == t->key[a]) && (b < a)) return b;
+    return a;
+}
+
+int tournament_init(Tournament * t, unsigned int size)
+{
+    unsigned int i;
+
+    t->size = size;
+    t->leaves = 1;
+    while (t->leaves < size) t->leaves *= 2;
+    t->key = (float*)malloc(size*sizeof(float));
+    t->winner = (int*)malloc(t->leaves*2*sizeof(int));
+    if ((t->key == NULL) || (t->winner == NULL)) return -1;
+    for (i = 0; i < size; i++) {
+        t->key[i] = -INFINITY;
+    }
+    tournament_build(t);
+    return 0;
+}
+
+void tournament_free(Tournament * t)
+{
+    free(t->key);
+    free(t->winner);
+    t->key = NULL;
+    t->winner = NULL;
+}
+
+/* recalculates all winners after the keys have been assigned */
+void tournament_build(Tournament * t)
+{
+    unsigned int i;
+
+    for (i = 0; i < t->leaves; i++) {
+        t->winner[t->leaves + i] = (i < t->size) ? (int)i : -1;
+    }
+    for (i = t->leaves - 1; i > 0; i--) {
+        t->winner[i] = tournament_winner(t, t->winner[i*2], t->winner[i*2 + 1]);
+    }
+}
+
+/* changes the key of an item and replays its matches */
+void tournament_set(Tournament * t, unsigned int item, float key)
+{
+    unsigned int i = (t->leaves + item) / 2;
+
+    t->key[item] = key;
+    while (i > 0) {
+        t->winner[i] = tournament_winner(t, t->winner[i*2], t->winner[i*2 + 1]);
+        i /= 2;
+    }
+}
+
+/* returns the winning item within the range [start, end), or -1 */
+int tournament_best(Tournament * t, unsigned int start, unsigned int end)
+{
+    int left = -1, right = -1;
+    unsigned int lo = start + t->leaves, hi = end + t->leaves;
+
+    while (lo < hi) {
+        if (lo & 1) left = tournament_winner(t, left, t->winner[lo++]);
+        if (hi & 1) right = tournament_winner(t, t->winner[--hi], right);
+        lo /= 2;
+        hi /= 2;
+    }
+    return tournament_winner(t, left, right);
+}
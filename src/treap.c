@@ -0,0 +1,229 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Treap of items ordered by a float key, with equal keys ordered by
+   descending item number. Each item also carries an integer weight,
+   and every node records the smallest weight within its subtree so
+   that the largest item below a given key having a weight below a
+   given limit can be found in logarithmic time. Nodes are identified
+   by item number, and the same storage may hold several trees */
+
+#include "econ.h"
+
+static unsigned int treap_priority(unsigned int item)
+{
+    unsigned int h = item * 2654435761u;
+    h ^= h >> 16;
+    h *= 2246822519u;
+    h ^= h >> 13;
+    return h;
+}
+
+/* returns non-zero if node a is ordered before node b */
+static int treap_before(Treap * t, int a, int b)
+{
+    if (t->key[a] < t->key[b]) return 1;
+    if (t->key[a] > t->key[b]) return 0;
+    return (a > b);
+}
+
+static void treap_refresh(Treap * t, int n)
+{
+    unsigned int w = t->weight[n];
+
+    if ((t->left[n] != -1) && (t->min_weight[t->left[n]] < w)) {
+        w = t->min_weight[t->left[n]];
+    }
+    if ((t->right[n] != -1) && (t->min_weight[t->right[n]] < w)) {
+        w = t->min_weight[t->right[n]];
+    }
+    t->min_weight[n] = w;
+}
+
+/* splits a tree into nodes with keys below the given value and the rest */
+static void treap_split(Treap * t, int n, float below, int * lower, int * upper)
+{
+    if (n == -1) {
+        *lower = -1;
+        *upper = -1;
+        return;
+    }
+    if (t->key[n] < below) {
+        treap_split(t, t->right[n], below, &t->right[n], upper);
+        *lower = n;
+    }
+    else {
+        treap_split(t, t->left[n], below, lower, &t->left[n]);
+        *upper = n;
+    }
+    treap_refresh(t, n);
+}
+
+/* splits a tree into nodes ordered before the given node and the rest */
+static void treap_split_at(Treap * t, int n, int item, int * lower, int * upper)
+{
+    if (n == -1) {
+        *lower = -1;
+        *upper = -1;
+        return;
+    }
+    if (treap_before(t, n, item)) {
+        treap_split_at(t, t->right[n], item, &t->right[n], upper);
+        *lower = n;
+    }
+    else {
+        treap_split_at(t, t->left[n], item, lower, &t->left[n]);
+        *upper = n;
+    }
+    treap_refresh(t, n);
+}
+
+/* joins two trees, where every node of the first is ordered before the second */
+static int treap_merge(Treap * t, int lower, int upper)
+{
+    if (lower == -1) return upper;
+    if (upper == -1) return lower;
+    if (t->priority[lower] > t->priority[upper]) {
+        t->right[lower] = treap_merge(t, t->right[lower], upper);
+        treap_refresh(t, lower);
+        return lower;
+    }
+    t->left[upper] = treap_merge(t, lower, t->left[upper]);
+    treap_refresh(t, upper);
+    return upper;
+}
+
+int treap_init(Treap * t, unsigned int size)
+{
+    unsigned int i;
+
+    t->size = size;
+    t->left = (int*)malloc(size*sizeof(int));
+    t->right = (int*)malloc(size*sizeof(int));
+    t->priority = (unsigned int*)malloc(size*sizeof(unsigned int));
+    t->key = (float*)malloc(size*sizeof(float));
+    t->weight = (unsigned int*)malloc(size*sizeof(unsigned int));
+    t->min_weight = (unsigned int*)malloc(size*sizeof(unsigned int));
+    if ((t->left == NULL) || (t->right == NULL) || (t->priority == NULL) ||
+        (t->key == NULL) || (t->weight == NULL) || (t->min_weight == NULL)) {
+        return -1;
+    }
+    for (i = 0; i < size; i++) {
+        t->priority[i] = treap_priority(i);
+    }
+    return 0;
+}
+
+void treap_free(Treap * t)
+{
+    free(t->left);
+    free(t->right);
+    free(t->priority);
+    free(t->key);
+    free(t->weight);
+    free(t->min_weight);
+    t->left = NULL;
+    t->right = NULL;
+    t->priority = NULL;
+    t->key = NULL;
+    t->weight = NULL;
+    t->min_weight = NULL;
+}
+
+/* inserts an item into the tree with the given root, returning the new root */
+int treap_insert(Treap * t, int root, unsigned int item, float key, unsigned int weight)
+{
+    int n = (int)item;
+
+    t->key[n] = key;
+    t->weight[n] = weight;
+    t->min_weight[n] = weight;
+    t->left[n] = -1;
+    t->right[n] = -1;
+
+    if (root == -1) return n;
+    if (t->priority[n] > t->priority[root]) {
+        treap_split_at(t, root, n, &t->left[n], &t->right[n]);
+        treap_refresh(t, n);
+        return n;
+    }
+    if (treap_before(t, n, root)) {
+        t->left[root] = treap_insert(t, t->left[root], item, key, weight);
+    }
+    else {
+        t->right[root] = treap_insert(t, t->right[root], item, key, weight);
+    }
+    treap_refresh(t, root);
+    return root;
+}
+
+/* removes an item from the tree with the given root, returning the new root */
+int treap_remove(Treap * t, int root, unsigned int item)
+{
+    int n = (int)item;
+
+    if (root == -1) return -1;
+    if (root == n) return treap_merge(t, t->left[n], t->right[n]);
+    if (treap_before(t, n, root)) {
+        t->left[root] = treap_remove(t, t->left[root], item);
+    }
+    else {
+        t->right[root] = treap_remove(t, t->right[root], item);
+    }
+    treap_refresh(t, root);
+    return root;
+}
+
+/* returns the last item in order having a key below the given value
+   and a weight below the given limit, or -1 if there is none */
+int treap_find(Treap * t, int * root, float below, unsigned int max_weight)
+{
+    int lower, upper, n, found = -1;
+
+    treap_split(t, *root, below, &lower, &upper);
+    n = lower;
+    if ((n != -1) && (t->min_weight[n] < max_weight)) {
+        while (n != -1) {
+            if ((t->right[n] != -1) &&
+                (t->min_weight[t->right[n]] < max_weight)) {
+                n = t->right[n];
+                continue;
+            }
+            if (t->weight[n] < max_weight) {
+                found = n;
+                break;
+            }
+            n = t->left[n];
+        }
+    }
+    *root = treap_merge(t, lower, upper);
+    return found;
+}
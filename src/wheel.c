@@ -0,0 +1,207 @@
+/****************************************************************
+
+ econ - a simple economics simulator
+
+ =============================================================
+
+ Copyright 2015 Bob Mottram
+
+ Permission is hereby granted, free of charge, to any person
+ obtaining a copy of this software and associated documentation
+ files (the "Software"), to deal in the Software without
+ restriction, including without limitation the rights to use,
+ copy, modify, merge, publish, distribute, sublicense, and/or
+ sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the followingp
+ conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/* Hierarchical timer wheel of items due on a given day. Each level has
+   a ring of slots, the first level holding one day per slot and each
+   level above covering a whole turn of the level below in each of its
+   slots. As the days advance, the items in each slot of a higher level
+   are moved down as its turn comes, and items in the current slot of the
+   first level become due. Scheduling and cancelling an item take constant
+   time, and advancing a day only visits the items which are due or which
+   move down a level. Items are linked through arrays indexed by item,
+   as with the other indexes */
+
+#include "econ.h"
+
+#define WHEEL_MASK  (WHEEL_SLOTS - 1)
+#define WHEEL_RANGE (1u << (WHEEL_BITS*WHEEL_LEVELS))
+#define WHEEL_DUE   (WHEEL_LEVELS*WHEEL_SLOTS)
+
+int wheel_init(Wheel * w, unsigned int capacity)
+{
+    w->capacity = 0;
+    w->next = NULL;
+    w->prev = NULL;
+    w->bucket = NULL;
+    w->when = NULL;
+    if (wheel_resize(w, capacity) != 0) return -1;
+    wheel_clear(w, 0);
+    return 0;
+}
+
+void wheel_free(Wheel * w)
+{
+    free(w->next);
+    free(w->prev);
+    free(w->bucket);
+    free(w->when);
+    w->next = NULL;
+    w->prev = NULL;
+    w->bucket = NULL;
+    w->when = NULL;
+    w->capacity = 0;
+}
+
+/* increases the number of items which may be scheduled */
+int wheel_resize(Wheel * w, unsigned int capacity)
+{
+    int * next, * prev, * bucket;
+    unsigned int * when, i;
+
+    if (capacity <= w->capacity) return 0;
+    next = (int*)realloc(w->next, capacity*sizeof(int));
+    if (next != NULL) w->next = next;
+    prev = (int*)realloc(w->prev, capacity*sizeof(int));
+    if (prev != NULL) w->prev = prev;
+    bucket = (int*)realloc(w->bucket, capacity*sizeof(int));
+    if (bucket != NULL) w->bucket = bucket;
+    when = (unsigned int*)realloc(w->when, capacity*sizeof(unsigned int));
+    if (when != NULL) w->when = when;
+    if ((next == NULL) || (prev == NULL) || (bucket == NULL) || (when == NULL)) return -1;
+
+    for (i = w->capacity; i < capacity; i++) {
+        w->bucket[i] = -1;
+    }
+    w->capacity = capacity;
+    return 0;
+}
+
+/* removes every item and sets the current day */
+void wheel_clear(Wheel * w, unsigned int now)
+{
+    unsigned int i;
+
+    w->now = now;
+    for (i = 0; i <= WHEEL_DUE; i++) {
+        w->head[i] = -1;
+    }
+    for (i = 0; i < w->capacity; i++) {
+        w->bucket[i] = -1;
+    }
+}
+
+/* returns the slot in which an item due on the given day belongs */
+static int wheel_bucket(Wheel * w, unsigned int when)
+{
+    unsigned int level, delta;
+
+    if (when <= w->now) return WHEEL_DUE;
+    delta = when - w->now;
+    if (delta >= WHEEL_RANGE) {
+        /* beyond the top level, so held there until it comes around */
+        when = w->now + WHEEL_RANGE - 1;
+        delta = WHEEL_RANGE - 1;
+    }
+    for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+        if (delta < (1u << (WHEEL_BITS*(level + 1)))) break;
+    }
+    return (int)(level*WHEEL_SLOTS + ((when >> (WHEEL_BITS*level)) & WHEEL_MASK));
+}
+
+static void wheel_link(Wheel * w, unsigned int item, int bucket)
+{
+    w->next[item] = w->head[bucket];
+    w->prev[item] = -1;
+    if (w->head[bucket] != -1) w->prev[w->head[bucket]] = (int)item;
+    w->head[bucket] = (int)item;
+    w->bucket[item] = bucket;
+}
+
+/* schedules an item on the given day. Items due on or before the
+   current day are due immediately */
+void wheel_insert(Wheel * w, unsigned int item, unsigned int when)
+{
+    if (w->bucket[item] != -1) wheel_remove(w, item);
+    w->when[item] = when;
+    wheel_link(w, item, wheel_bucket(w, when));
+}
+
+void wheel_remove(Wheel * w, unsigned int item)
+{
+    int bucket = w->bucket[item];
+
+    if (bucket == -1) return;
+    if (w->prev[item] != -1) {
+        w->next[w->prev[item]] = w->next[item];
+    }
+    else {
+        w->head[bucket] = w->next[item];
+    }
+    if (w->next[item] != -1) w->prev[w->next[item]] = w->prev[item];
+    w->bucket[item] = -1;
+}
+
+/* moves the items within a slot of a higher level down */
+static void wheel_cascade(Wheel * w, int bucket)
+{
+    int item = w->head[bucket], next;
+
+    w->head[bucket] = -1;
+    while (item != -1) {
+        next = w->next[item];
+        wheel_link(w, (unsigned int)item, wheel_bucket(w, w->when[item]));
+        item = next;
+    }
+}
+
+/* advances to the given day, after which the items which have become
+   due may be taken with wheel_pop */
+void wheel_advance(Wheel * w, unsigned int now)
+{
+    unsigned int level;
+    int item, next, bucket;
+
+    while (w->now != now) {
+        w->now++;
+        for (level = WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((w->now & ((1u << (WHEEL_BITS*level)) - 1)) != 0) continue;
+            wheel_cascade(w, (int)(level*WHEEL_SLOTS +
+                                   ((w->now >> (WHEEL_BITS*level)) & WHEEL_MASK)));
+        }
+        bucket = (int)(w->now & WHEEL_MASK);
+        item = w->head[bucket];
+        w->head[bucket] = -1;
+        while (item != -1) {
+            next = w->next[item];
+            wheel_link(w, (unsigned int)item, WHEEL_DUE);
+            item = next;
+        }
+    }
+}
+
+/* takes the next item which is due, or returns -1 if there are none */
+int wheel_pop(Wheel * w)
+{
+    int item = w->head[WHEEL_DUE];
+
+    if (item != -1) wheel_remove(w, (unsigned int)item);
+    return item;
+}